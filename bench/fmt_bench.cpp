@@ -0,0 +1,76 @@
+// 汇编格式化的微基准: 同一组指令分别用 string 拼接 (原来的写法) 和 asm_fmt.hpp 格式化,
+// 输出每秒格式化的指令数; 用法: fmt_bench [轮数];
+#include "asm_fmt.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// 每轮格式化的指令条数;
+const int INSTS_PER_ROUND = 8;
+
+// 与 code_gen.cpp 原来的写法相同, 每条指令由若干临时 string 拼接而成;
+void concatRound(string &out, int i)
+{
+    string reg = "t0", base = "sp", label = "while_entry_3";
+    out += "\tlw " + reg + ", " + to_string(i & 2047) + "(" + base + ")\n";
+    out += "\tsw " + reg + ", " + to_string(-(i & 2047)) + "(" + base + ")\n";
+    out += "\taddi " + reg + ", " + reg + ", " + to_string(i % 100) + "\n";
+    out += "\tli t6, " + to_string(i * 4096) + "\n";
+    out += "\tadd " + reg + ", " + base + ", t6\n";
+    out += "\tslli t2, " + reg + ", " + to_string(i & 31) + "\n";
+    out += "\tbnez " + reg + ", " + label + "\n";
+    out += "\tj " + string(label.c_str()) + "\n";
+}
+
+void fmtRound(string &out, int i)
+{
+    string reg = "t0", base = "sp", label = "while_entry_3";
+    fmtInst(out, "lw", reg, Mem(i & 2047, base));
+    fmtInst(out, "sw", reg, Mem(-(i & 2047), base));
+    fmtInst(out, "addi", reg, reg, i % 100);
+    fmtInst(out, "li", "t6", i * 4096);
+    fmtInst(out, "add", reg, base, "t6");
+    fmtInst(out, "slli", "t2", reg, i & 31);
+    fmtInst(out, "bnez", reg, Label(label));
+    fmtInst(out, "j", Label(label.c_str()));
+}
+
+// 按函数为单位清空输出缓冲区, 与 code_gen 的用法一致;
+template <typename F>
+double run(const char *name, F round, int rounds, size_t &bytes)
+{
+    string out;
+    bytes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+        round(out, i);
+        if (out.size() > 64 * 1024)
+        {
+            bytes += out.size();
+            out.clear();
+        }
+    }
+    bytes += out.size();
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double rate = rounds * (double)INSTS_PER_ROUND / sec;
+    cout << name << ": " << (long long)rate << " insts/s (" << bytes << " bytes, " << sec << " s)" << endl;
+    return rate;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000000;
+    size_t concat_bytes, fmt_bytes;
+    double before = run("string concat", concatRound, rounds, concat_bytes);
+    double after = run("asm_fmt      ", fmtRound, rounds, fmt_bytes);
+    if (concat_bytes != fmt_bytes)
+    {
+        cerr << "output size mismatch" << endl;
+        return 1;
+    }
+    cout << "speedup: " << after / before << "x" << endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+// 符号表的微基准: 深度嵌套的作用域中定义数千个标识符, 在最内层反复查找,
+// 分别用原来的逐层查找写法和 symbol_table.hpp 的遮蔽链写法, 输出每秒查找次数;
+// 用法: symtab_bench [嵌套深度] [每层标识符数] [查找次数];
+#include "symbol_table.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// 与 ast.cpp 原来的写法相同: 每层一个以 string 为键的表, 从内到外逐层查找, 按值返回;
+class OldSymbolTableStack
+{
+    vector<unordered_map<string, Symbol>> stk;
+    int dep_label_no = 0;
+
+public:
+    OldSymbolTableStack() : stk(1) {}
+    void inc()
+    {
+        stk.emplace_back();
+        dep_label_no++;
+    }
+    void dec() { stk.pop_back(); }
+    void insert(string id, int val)
+    {
+        string name = id + "_" + to_string(dep_label_no);
+        stk.back()[id] = Symbol(_VAR, _INT, val, name);
+    }
+    // 原来的调用方每次查找都构造 string(ident);
+    Symbol get(string_view ident)
+    {
+        string id(ident);
+        for (auto it = stk.rbegin(); it != stk.rend(); it++)
+        {
+            if (it->find(id) != it->end())
+            {
+                cerr << "//! get:" << id << endl;
+                return (*it)[id];
+            }
+        }
+        assert(0);
+        return Symbol();
+    }
+};
+
+struct Workload
+{
+    int depth, width;
+    long long lookups;
+    vector<string> idents; // 第 d 层定义 idents[d * width ... (d + 1) * width), 另外每层都定义 "x" 遮蔽外层;
+    vector<int> queries;   // 查找的标识符下标, -1 表示 "x";
+};
+
+// 两种写法执行同样的操作: 逐层进入作用域并定义标识符, 在最内层查找, 再逐层退出;
+template <typename Table>
+double run(const char *name, Table &table, const Workload &w, long long &checksum)
+{
+    checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int d = 0; d < w.depth; ++d)
+    {
+        table.inc();
+        table.insert("x", d);
+        for (int i = 0; i < w.width; ++i)
+            table.insert(w.idents[d * w.width + i], i);
+    }
+    for (long long k = 0; k < w.lookups; ++k)
+    {
+        int q = w.queries[k % w.queries.size()];
+        string_view id = q < 0 ? string_view("x") : string_view(w.idents[q]);
+        const Symbol &symbol = table.get(id);
+        checksum += symbol.getVal() + symbol.getName().size();
+    }
+    for (int d = 0; d < w.depth; ++d)
+        table.dec();
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double rate = w.lookups / sec;
+    cout << name << ": " << (long long)rate << " lookups/s (" << sec << " s)" << endl;
+    return rate;
+}
+
+// 新写法的适配: 调用方直接传 string_view, 不构造临时 string;
+struct NewTable
+{
+    SymbolTableStack table;
+    void inc() { table.inc(); }
+    void dec() { table.dec(); }
+    void insert(string_view id, int val) { table.insert(id, val, _VAR, _INT); }
+    const Symbol &get(string_view id) { return table.get(id); }
+};
+
+int main(int argc, char *argv[])
+{
+    Workload w;
+    w.depth = argc > 1 ? atoi(argv[1]) : 256;
+    w.width = argc > 2 ? atoi(argv[2]) : 16;
+    w.lookups = argc > 3 ? atoll(argv[3]) : 200000;
+    for (int i = 0; i < w.depth * w.width; ++i)
+        w.idents.push_back("var_" + to_string(i));
+    // 固定种子的线性同余序列, 外层的标识符和被遮蔽的 "x" 混合查找;
+    unsigned seed = 12345;
+    for (int i = 0; i < 4096; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        int r = (seed >> 8) % (w.idents.size() + w.idents.size() / 8);
+        w.queries.push_back(r < (int)w.idents.size() ? r : -1);
+    }
+
+    // 两种写法都有调试输出, 不计入查找的时间;
+    cerr.setstate(ios::badbit);
+    cout << "depth " << w.depth << ", " << w.idents.size() << " identifiers" << endl;
+    long long old_sum, new_sum;
+    OldSymbolTableStack old_table;
+    double before = run("scope scan  ", old_table, w, old_sum);
+    NewTable new_table;
+    double after = run("shadow chain", new_table, w, new_sum);
+    cerr.clear();
+    if (old_sum != new_sum)
+    {
+        cerr << "checksum mismatch" << endl;
+        return 1;
+    }
+    cout << "speedup: " << after / before << "x" << endl;
+    return 0;
+}
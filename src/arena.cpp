@@ -0,0 +1,27 @@
+#include "arena.hpp"
+
+void Arena::grow(size_t size)
+{
+    size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    char *chunk = new char[chunk_size];
+    chunks.push_back(chunk);
+    cur = chunk;
+    end = chunk + chunk_size;
+}
+
+const char *Arena::newStr(const char *s, size_t len)
+{
+    char *buf = static_cast<char *>(alloc(len + 1, 1));
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+void Arena::clear()
+{
+    for (auto chunk : chunks)
+        delete[] chunk;
+    chunks.clear();
+    cur = end = nullptr;
+    alloc_bytes = 0;
+}
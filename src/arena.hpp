@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+
+// bump-pointer 分配器, 所有对象在 clear() 或析构时一次性释放;
+// 不会调用对象的析构函数, 所以只能存放不持有其他堆内存的对象;
+class Arena
+{
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    vector<char *> chunks;
+    char *cur = nullptr;
+    char *end = nullptr;
+    size_t alloc_bytes = 0;
+
+    void grow(size_t size);
+
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { clear(); }
+
+    void *alloc(size_t size, size_t align = alignof(max_align_t))
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+        if (!cur || p + size > reinterpret_cast<uintptr_t>(end))
+        {
+            grow(size + align);
+            p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        cur = reinterpret_cast<char *>(p + size);
+        alloc_bytes += size;
+        return reinterpret_cast<void *>(p);
+    }
+
+    // 值初始化, C 结构体会被清零;
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        return new (alloc(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    }
+
+    const char *newStr(const char *s, size_t len);
+
+    void clear();
+    size_t chunkCount() { return chunks.size(); }
+    size_t allocBytes() { return alloc_bytes; }
+};
+
+// 存放在 arena 中的只增长数组, 扩容时旧的空间留在 arena 里一起释放;
+template <typename T>
+class ArenaVec
+{
+    static_assert(is_trivially_copyable<T>::value, "ArenaVec only holds trivially copyable elements");
+
+    Arena *arena = nullptr;
+    T *buf = nullptr;
+    size_t len = 0;
+    size_t cap = 0;
+
+public:
+    ArenaVec() = default;
+    explicit ArenaVec(Arena *a) : arena(a) {}
+
+    void push_back(const T &v)
+    {
+        if (len == cap)
+        {
+            assert(arena);
+            size_t new_cap = cap ? cap * 2 : 4;
+            T *new_buf = static_cast<T *>(arena->alloc(sizeof(T) * new_cap, alignof(T)));
+            if (len)
+                memcpy(new_buf, buf, sizeof(T) * len);
+            buf = new_buf;
+            cap = new_cap;
+        }
+        buf[len++] = v;
+    }
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T &operator[](size_t i) { return buf[i]; }
+    const T &operator[](size_t i) const { return buf[i]; }
+    T &back() { return buf[len - 1]; }
+    T *begin() { return buf; }
+    T *end() { return buf + len; }
+    const T *begin() const { return buf; }
+    const T *end() const { return buf + len; }
+};
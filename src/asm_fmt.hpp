@@ -0,0 +1,87 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// 汇编文本的格式化: 操作数按类型直接写入输出缓冲区, 整数用 to_chars 转换, 不产生临时 string;
+// 用法: fmtInst(out, "lw", Reg("t0"), Mem(8, "sp")) 输出 "\tlw t0, 8(sp)\n";
+
+// 寄存器, 只引用名字, 不复制;
+struct Reg
+{
+    string_view name;
+    Reg(const char *_name) : name(_name) {}
+    Reg(const string &_name) : name(_name) {}
+};
+
+// 立即数;
+struct Imm
+{
+    long long value;
+    Imm(long long _value) : value(_value) {}
+};
+
+// 基本块标号或全局符号;
+struct Label
+{
+    string_view name;
+    explicit Label(const char *_name) : name(_name) {}
+    explicit Label(const string &_name) : name(_name) {}
+};
+
+// 访存地址 offset(base);
+struct Mem
+{
+    long long offset;
+    Reg base;
+    Mem(long long _offset, Reg _base) : offset(_offset), base(_base) {}
+};
+
+inline void fmtOperand(string &out, const Imm &imm)
+{
+    char buf[24];
+    auto res = to_chars(buf, buf + sizeof(buf), imm.value);
+    out.append(buf, res.ptr - buf);
+}
+
+inline void fmtOperand(string &out, const Reg &reg)
+{
+    out.append(reg.name);
+}
+
+inline void fmtOperand(string &out, const Label &label)
+{
+    out.append(label.name);
+}
+
+inline void fmtOperand(string &out, const Mem &mem)
+{
+    fmtOperand(out, Imm(mem.offset));
+    out += '(';
+    out.append(mem.base.name);
+    out += ')';
+}
+
+// 一条指令或伪指令: "\top a, b, c\n";
+template <typename... Ops>
+void fmtInst(string &out, string_view op, const Ops &...ops)
+{
+    out += '\t';
+    out.append(op);
+    if constexpr (sizeof...(ops) > 0)
+    {
+        const char *sep = " ";
+        ((out.append(sep), sep = ", ", fmtOperand(out, ops)), ...);
+    }
+    out += '\n';
+}
+
+// 标号定义: "name:\n";
+inline void fmtLabel(string &out, string_view name)
+{
+    out.append(name);
+    out.append(":\n");
+}
@@ -1,415 +1,296 @@
 #include "ast.hpp"
 
-unordered_map<string, string> op2ir =
+const koopa_raw_binary_op_t op2ir[] =
     {
-        {"+", "add"},
-        {"-", "sub"},
-        {"*", "mul"},
-        {"/", "div"},
-        {"%", "mod"},
-        {"<", "lt"},
-        {">", "gt"},
-        {"<=", "le"},
-        {">=", "ge"},
-        {"==", "eq"},
-        {"!=", "ne"}};
-
-int sym_no = 0;      // 下一个可用的临时变量的编号;
-int if_label_no = 0; // 下一个可用的if_label的编号;
-
-int cur_basic_block = 0; // 用于判断当前程序块是否已经生成了br, jump或ret指令;
-unordered_map<int, bool> is_end;
-
-int while_label_no = 0;   // 下一个可用的while_label的编号;
-int cur_while_level = -1; // 现在所处位置的while_label编号;
-unordered_map<int, int> while_parent;
-
-int cur_scope = 0; // 现在所处的作用域;
-unordered_map<int, int> scope_parent;
-
-string cur_func_type;
-
-void SymbolTable::insert(string id, int val, SYM_TYPE s_type, DATA_TYPE d_type, string name)
-{
-    // cout << "insert:" << id << ", " << val << ", " << is_const << endl;
-    assert(table.find(id) == table.end());
-    table[id] = Symbol(s_type, d_type, val, name);
-    // debug();
-}
+        KOOPA_RBO_ADD,    // OP_ADD
+        KOOPA_RBO_SUB,    // OP_SUB
+        KOOPA_RBO_MUL,    // OP_MUL
+        KOOPA_RBO_DIV,    // OP_DIV
+        KOOPA_RBO_MOD,    // OP_MOD
+        KOOPA_RBO_LT,     // OP_LT
+        KOOPA_RBO_GT,     // OP_GT
+        KOOPA_RBO_LE,     // OP_LE
+        KOOPA_RBO_GE,     // OP_GE
+        KOOPA_RBO_EQ,     // OP_EQ
+        KOOPA_RBO_NOT_EQ, // OP_NE
+};
 
-void SymbolTable::insert(string id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type, string name)
+koopa_raw_type_t _array_type(CompileContext &ctx, vector<int> shape)
 {
-    if (table.find(id) != table.end())
-    {
-        cerr << "---Symbol " << id << " has already been defined---" << endl;
-        assert(0);
-    }
-    assert(array_shape_table.find(id) == array_shape_table.end());
-    table[id] = Symbol(s_type, d_type, 0, name);
-    array_shape_table[id] = shape;
+    koopa_raw_type_t ty = ctx.ir_builder.int32Type();
+    for (auto it = shape.rbegin(); it != shape.rend(); it++)
+        ty = ctx.ir_builder.arrayType(ty, *it);
+    return ty;
 }
 
-bool SymbolTable::exist(string id)
+koopa_raw_value_t _generate(CompileContext &ctx, EXP_OP op, RetVal lret_val, RetVal rret_val)
 {
-    return table.find(id) != table.end();
+    assert(op <= OP_NE);
+    return ctx.ir_builder.binary(op2ir[op], lret_val.getValue(ctx.ir_builder), rret_val.getValue(ctx.ir_builder));
 }
 
-Symbol SymbolTable::get(string id)
+vector<int> arrayWidths(const vector<int> &shape)
 {
-    cerr << "//! get:" << id << endl;
-    assert(table.find(id) != table.end());
-
-    return table[id];
-}
-vector<int> SymbolTable::getArray(string id)
-{
-    cerr << "//! get array shape:" << id << endl;
-    assert(array_shape_table.find(id) != array_shape_table.end());
-
-    return array_shape_table[id];
+    vector<int> width(shape);
+    width.push_back(1);
+    for (int i = (int)shape.size() - 2; i >= 0; --i)
+        width[i] *= width[i + 1];
+    return width;
 }
 
-SymbolTableStack::SymbolTableStack()
+// 从 vals[k] 开始取出偏移落在以 base 为起点, 第 dim 维开始的子数组内的初值;
+// 没有初值的子数组直接用 zeroinit 表示;
+static koopa_raw_value_t _array_init_val(CompileContext &ctx, const vector<pair<int, int>> &vals, size_t &k, int base,
+                                         const vector<int> &shape, const vector<int> &width, int dim)
 {
-    stk.push_back(SymbolTable());
-
-    cerr << "//! construct symbol table stack\n";
-}
+    vector<int> _shape(shape.begin() + dim, shape.end());
+    if (k == vals.size() || vals[k].first >= base + width[dim])
+        return ctx.ir_builder.zeroInit(_array_type(ctx, _shape));
 
-bool SymbolTableStack::inc()
-{
-    assert(!stk.empty());
-    if (stk.back().forAllocParam())
+    vector<const void *> elems;
+    int n = shape[dim];
+    if (dim + 1 == (int)shape.size())
     {
-        cerr << "//! symbol table common\n";
-        stk.back().common();
-        return true;
+        for (int i = 0; i < n; ++i)
+        {
+            int val = 0;
+            if (k < vals.size() && vals[k].first == base + i)
+                val = vals[k++].second;
+            elems.push_back(ctx.ir_builder.integer(val));
+        }
     }
     else
     {
-        cerr << "//! symbol table inc, ";
-        stk.push_back(SymbolTable());
-        dep_label_no++;
-        cerr << "now " << stk.size() << endl;
-        return false;
+        for (int i = 0; i < n; ++i)
+            elems.push_back(_array_init_val(ctx, vals, k, base + i * width[dim + 1], shape, width, dim + 1));
     }
+    return ctx.ir_builder.aggregate(_array_type(ctx, _shape), elems);
 }
 
-void SymbolTableStack::dec()
+// 全局数组的初值, 初值表达式都在编译期求出;
+koopa_raw_value_t getArrayInitVal(CompileContext &ctx, const SparseInit &init, const vector<int> &shape)
 {
-    cerr << "//! symbol table dec, ";
-    assert(!stk.empty());
-    stk.pop_back();
-    // 这里dep_lable_no不能减一, 否则重名;
-
-    cerr << "now " << stk.size() << endl;
+    vector<pair<int, int>> vals;
+    for (auto &item : init)
+    {
+        int val = item.second->Cal(ctx);
+        if (val)
+            vals.emplace_back(item.first, val);
+    }
+    size_t k = 0;
+    return _array_init_val(ctx, vals, k, 0, shape, arrayWidths(shape), 0);
 }
 
-void SymbolTableStack::incParam()
-{
-    cerr << "//! symbol table inc param, ";
-    stk.push_back(SymbolTable(1));
-    dep_label_no++;
-    cerr << "now " << stk.size() << endl;
-}
+// 连续的 0 不少于该长度时用循环清零, 否则逐个 store;
+const int ZERO_LOOP_MIN = 16;
+// 清零循环每轮 store 的元素个数;
+const int ZERO_LOOP_UNROLL = 4;
 
-string SymbolTableStack::insert(string id, int val, SYM_TYPE s_type, DATA_TYPE d_type)
+// 用循环把 elem 开始的第 [begin, end) 个元素清零, 循环体每轮清零 ZERO_LOOP_UNROLL 个;
+// 下标变量和其他局部变量一样分配在入口基本块中;
+static void _zero_loop(CompileContext &ctx, koopa_raw_value_t elem, int begin, int end)
 {
-    assert(!stk.empty());
-    cerr << "//! insert " << id << endl;
+    string no = to_string(ctx.zero_loop_no++);
 
-    string name = id + "_" + to_string(cur_scope);
+    koopa_raw_type_t i32 = ctx.ir_builder.int32Type();
+    koopa_raw_value_t zero = ctx.ir_builder.integer(0);
+    koopa_raw_value_t idx = ctx.ir_builder.alloc("@zero_idx_" + no, i32);
+    ctx.ir_builder.store(ctx.ir_builder.integer(begin), idx);
 
-    if (s_type == _FUNC)
-        name = id;
-    stk.back().insert(id, val, s_type, d_type, name);
+    koopa_raw_basic_block_t entry_bb = ctx.ir_builder.newBlock("%zero_entry_" + no);
+    koopa_raw_basic_block_t body_bb = ctx.ir_builder.newBlock("%zero_body_" + no);
+    koopa_raw_basic_block_t end_bb = ctx.ir_builder.newBlock("%zero_end_" + no);
+    ctx.ir_builder.jump(entry_bb);
 
-    return name;
-}
+    ctx.ir_builder.setBlock(entry_bb);
+    koopa_raw_value_t i = ctx.ir_builder.load(idx);
+    ctx.ir_builder.branch(ctx.ir_builder.binary(KOOPA_RBO_LT, i, ctx.ir_builder.integer(end)), body_bb, end_bb);
 
-string SymbolTableStack::insert(string id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type)
-{
-    assert(!stk.empty());
-    cerr << "//! insert array " << id << endl;
+    ctx.ir_builder.setBlock(body_bb);
+    i = ctx.ir_builder.load(idx);
+    koopa_raw_value_t ptr = ctx.ir_builder.getPtr(elem, i);
+    ctx.ir_builder.store(zero, ptr);
+    for (int k = 1; k < ZERO_LOOP_UNROLL; ++k)
+        ctx.ir_builder.store(zero, ctx.ir_builder.getPtr(ptr, ctx.ir_builder.integer(k)));
+    ctx.ir_builder.store(ctx.ir_builder.binary(KOOPA_RBO_ADD, i, ctx.ir_builder.integer(ZERO_LOOP_UNROLL)), idx);
+    ctx.ir_builder.jump(entry_bb);
 
-    string name = id + "_" + to_string(cur_scope);
-
-    if (s_type == _FUNC)
-        name = id;
-    stk.back().insert(id, shape, s_type, d_type, name);
-
-    return name;
+    ctx.ir_builder.setBlock(end_bb);
 }
 
-bool SymbolTableStack::exist(string id)
+// 局部数组的初始化: vals 为偏移递增的 (元素偏移, 初值), 按展平后的偏移访问首元素指针;
+// 非 0 元素和较短的 0 段逐个 store, 较长的 0 段交给 _zero_loop, 生成的代码长度与数组大小无关;
+void localArrayInit(CompileContext &ctx, koopa_raw_value_t base, const vector<pair<int, koopa_raw_value_t>> &vals, const vector<int> &shape)
 {
-    for (auto it = stk.rbegin(); it != stk.rend(); it++)
-    {
-        if (it->exist(id))
-            return true;
-    }
-    return false;
-}
+    cerr << "//! localarrayinit\n";
+    koopa_raw_value_t elem = base;
+    for (size_t d = 0; d < shape.size(); ++d)
+        elem = ctx.ir_builder.getElemPtr(elem, ctx.ir_builder.integer(0));
 
-Symbol SymbolTableStack::get(string id)
-{
-    for (auto it = stk.rbegin(); it != stk.rend(); it++)
-    {
-        if (it->exist(id))
-            return it->get(id);
-    }
-    cerr << "---Undefined symbol: " << id << "---" << endl;
-    assert(0);
-}
-vector<int> SymbolTableStack::getArray(string id)
-{
-    for (auto it = stk.rbegin(); it != stk.rend(); it++)
+    auto store = [&](koopa_raw_value_t val, int pos)
     {
-        if (it->exist(id))
-            return it->getArray(id);
-    }
-    assert(0);
-}
-Symbol SymbolTableStack::getFromGlobal(string id)
-{
-    return stk.front().get(id);
-}
-
-SymbolTableStack symbol_table;
-
-// 两个操作数都是数字;
-string _generate_b(int l, string op, int r)
-{
-    // assert(op2ir.find(op) != op2ir.end());
-    return "\t%" + to_string(sym_no) + " = " + op2ir[op] + " " + to_string(l) + ", " + to_string(r) + "\n";
-}
-
-// 左操作数是数字;
-string _generate_l(int l, string op, int sno_r)
-{
-    return "\t%" + to_string(sym_no) + " = " + op2ir[op] + " " + to_string(l) + ", %" + to_string(sno_r) + "\n";
-}
-
-// 右操作数是数字;
-string _generate_r(int sno_l, string op, int r)
-{
-    return "\t%" + to_string(sym_no) + " = " + op2ir[op] + " %" + to_string(sno_l) + ", " + to_string(r) + "\n";
-}
-
-// 两个操作数都不是数字;
-string _generate_n(int sno_l, string op, int sno_r)
-{
-    return "\t%" + to_string(sym_no) + " = " + op2ir[op] + " %" + to_string(sno_l) + ", %" + to_string(sno_r) + "\n";
-}
-
-string getArrayInitVal(vector<int> *vec, int s_pos, vector<int> shape)
-{
-    string ret = "{";
-    int n = shape[0];
-    vector<int> _shape(shape.begin() + 1, shape.end());
-    if (_shape.empty())
+        ctx.ir_builder.store(val, ctx.ir_builder.getPtr(elem, ctx.ir_builder.integer(pos)));
+    };
+    // 把 [pos, end) 清零;
+    int pos = 0;
+    auto zeros = [&](int end)
     {
-
-        bool first = true;
-        for (int i = 0; i < n; ++i)
+        if (end - pos >= ZERO_LOOP_MIN)
         {
-            if (!first)
-                ret += ", ";
-            ret += to_string((*vec)[i + s_pos]);
-            first = false;
+            int len = (end - pos) / ZERO_LOOP_UNROLL * ZERO_LOOP_UNROLL;
+            _zero_loop(ctx, elem, pos, pos + len);
+            pos += len;
         }
-    }
-    else
+        for (; pos < end; ++pos)
+            store(ctx.ir_builder.integer(0), pos);
+    };
+    for (auto &item : vals)
     {
-        int width = 1;
-        for (auto s : _shape)
-            width *= s;
-
-        bool first = true;
-        for (int i = 0; i < n; ++i)
-        {
-            if (!first)
-                ret += ", ";
-            ret += getArrayInitVal(vec, s_pos + i * width, _shape);
-            first = false;
-        }
+        auto val = item.second;
+        if (val->kind.tag == KOOPA_RVT_INTEGER && val->kind.data.integer.value == 0)
+            continue;
+        zeros(item.first);
+        store(val, item.first);
+        pos = item.first + 1;
     }
-    ret += "}";
-    return ret;
+    zeros(arrayWidths(shape)[0]);
 }
 
-string localArrayInit(string name, vector<int> *vec, int s_pos, vector<int> shape)
+RetVal StartSymbolAST::Dump(CompileContext &ctx) const
 {
-    cerr << "//! localarrayinit\n";
-    string ret;
-    int n = shape[0];
-    vector<int> _shape(shape.begin() + 1, shape.end());
-    int width = 1;
-    for (auto s : _shape)
-        width *= s;
-
-    for (int i = 0; i < n; ++i)
-    {
-        ret += "\t%" + to_string(sym_no) + " = getelemptr " + name + ", " + to_string(i) + "\n";
-        sym_no++;
+    koopa_raw_type_t i32 = ctx.ir_builder.int32Type();
+    koopa_raw_type_t unit = ctx.ir_builder.unitType();
+    ctx.ir_builder.declFunc("@getint", {}, i32);
+    ctx.ir_builder.declFunc("@getch", {}, i32);
+    ctx.ir_builder.declFunc("@getarray", {ctx.ir_builder.pointerType(i32)}, i32);
+    ctx.ir_builder.declFunc("@putint", {i32}, unit);
+    ctx.ir_builder.declFunc("@putch", {i32}, unit);
+    ctx.ir_builder.declFunc("@putarray", {i32, ctx.ir_builder.pointerType(i32)}, unit);
+    ctx.ir_builder.declFunc("@starttime", {}, unit);
+    ctx.ir_builder.declFunc("@stoptime", {}, unit);
 
-        if (_shape.empty())
-            ret += "\tstore " + to_string((*vec)[i + s_pos]) + ", %" + to_string(sym_no - 1) + "\n";
-        else
-            ret += localArrayInit("%" + to_string(sym_no - 1), vec, s_pos + i * width, _shape);
-    }
+    ctx.symbol_table.insert("getint", 0, _FUNC, _INT);
+    ctx.symbol_table.insert("getch", 0, _FUNC, _INT);
+    ctx.symbol_table.insert("getarray", 0, _FUNC, _INT);
+    ctx.symbol_table.insert("putint", 0, _FUNC, _VOID);
+    ctx.symbol_table.insert("putch", 0, _FUNC, _VOID);
+    ctx.symbol_table.insert("putarray", 0, _FUNC, _VOID);
+    ctx.symbol_table.insert("starttime", 0, _FUNC, _VOID);
+    ctx.symbol_table.insert("stoptime", 0, _FUNC, _VOID);
 
-    return ret;
-}
-RetVal StartSymbolAST::Dump() const
-{
-    koopa_ret_str += "decl @getint(): i32\n";
-    koopa_ret_str += "decl @getch(): i32\n";
-    koopa_ret_str += "decl @getarray(*i32): i32\n";
-    koopa_ret_str += "decl @putint(i32)\n";
-    koopa_ret_str += "decl @putch(i32)\n";
-    koopa_ret_str += "decl @putarray(i32, *i32)\n";
-    koopa_ret_str += "decl @starttime()\n";
-    koopa_ret_str += "decl @stoptime()\n\n";
-
-    symbol_table.insert("getint", 0, _FUNC, _INT);
-    symbol_table.insert("getch", 0, _FUNC, _INT);
-    symbol_table.insert("getarray", 0, _FUNC, _INT);
-    symbol_table.insert("putint", 0, _FUNC, _VOID);
-    symbol_table.insert("putch", 0, _FUNC, _VOID);
-    symbol_table.insert("putarray", 0, _FUNC, _VOID);
-    symbol_table.insert("starttime", 0, _FUNC, _VOID);
-    symbol_table.insert("stoptime", 0, _FUNC, _VOID);
-
-    return compunit->Dump();
+    return compunit->Dump(ctx);
 }
 
-RetVal CompUnitAST::Dump() const
+RetVal CompUnitAST::Dump(CompileContext &ctx) const
 {
     cerr << "//! compunit\n";
     if (compunit)
-        (*compunit)->Dump();
-    funcdef_decl->Dump();
+        compunit->Dump(ctx);
+    funcdef_decl->Dump(ctx);
     return RetVal();
 }
 
-RetVal FuncDefAST::Dump() const
+RetVal FuncDefAST::Dump(CompileContext &ctx) const
 {
-    cerr << "//! funcdef, cur scope: " << cur_scope << endl;
-
-    sym_no = 0;
+    cerr << "//! funcdef, cur scope: " << ctx.cur_scope << endl;
 
-    cur_func_type = functype;
+    ctx.cur_func_type = functype;
 
     if (functype == "int")
-        symbol_table.insert(ident, 0, _FUNC, _INT);
+        ctx.symbol_table.insert(ident, 0, _FUNC, _INT);
     else if (functype == "void")
-        symbol_table.insert(ident, 0, _FUNC, _VOID);
+        ctx.symbol_table.insert(ident, 0, _FUNC, _VOID);
     else
         assert(0);
 
-    symbol_table.incParam();
+    ctx.symbol_table.incParam();
 
-    scope_parent[symbol_table.getDepLabelNo()] = cur_scope;
-    cur_scope = symbol_table.getDepLabelNo();
+    ctx.scope_parent[ctx.symbol_table.getDepLabelNo()] = ctx.cur_scope;
+    ctx.cur_scope = ctx.symbol_table.getDepLabelNo();
 
-    koopa_ret_str += ("fun @" + ident + "( ");
+    if (functype == "int")
+        ctx.ir_builder.beginFunc("@" + string(ident), ctx.ir_builder.int32Type());
+    else
+        ctx.ir_builder.beginFunc("@" + string(ident), ctx.ir_builder.unitType());
 
     if (params)
-        (*params)->Dump();
-
-    koopa_ret_str += " )";
-
-    if (functype == "int")
-        koopa_ret_str += ": i32";
+        params->Dump(ctx);
 
     cerr << "//! entry of func:" << ident << endl;
 
-    koopa_ret_str += " {\n%entry :\n ";
+    ctx.ir_builder.setBlock(ctx.ir_builder.newBlock("%entry"));
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
     if (params)
-        (*params)->Alloc();
+        params->Alloc(ctx);
 
-    block->Dump();
+    block->Dump(ctx);
 
-    if (functype == "void" && !is_end[cur_basic_block])
-        koopa_ret_str += "\tret\n";
+    if (functype == "void" && !ctx.is_end[ctx.cur_basic_block])
+        ctx.ir_builder.ret(nullptr);
 
-    if (functype == "int" && !is_end[cur_basic_block])
-        koopa_ret_str += "\tret 0\n";
+    if (functype == "int" && !ctx.is_end[ctx.cur_basic_block])
+        ctx.ir_builder.ret(ctx.ir_builder.integer(0));
 
-    is_end[cur_basic_block] = true;
+    ctx.is_end[ctx.cur_basic_block] = true;
 
-    koopa_ret_str += "}\n";
+    ctx.ir_builder.endFunc();
 
-    cur_scope = scope_parent[cur_scope];
+    ctx.cur_scope = ctx.scope_parent[ctx.cur_scope];
 
-    cerr << "//! func def end, cur scope: " << cur_scope << endl;
+    cerr << "//! func def end, cur scope: " << ctx.cur_scope << endl;
 
     return RetVal();
 }
 
-RetVal FuncFParamsAST::Dump() const
+RetVal FuncFParamsAST::Dump(CompileContext &ctx) const
 {
-
-    bool first = true;
     for (auto &param : funcfparams)
-    {
-        if (!first)
-            koopa_ret_str += ", ";
-        param->Dump();
-        first = false;
-    }
+        param->Dump(ctx);
 
     return RetVal();
 }
 
-RetVal FuncFParamsAST::Alloc() const
+RetVal FuncFParamsAST::Alloc(CompileContext &ctx) const
 {
-    for (auto &param : funcfparams)
+    for (size_t i = 0; i < funcfparams.size(); ++i)
     {
-        param->Alloc();
+        funcfparams[i]->Alloc(ctx, ctx.ir_builder.getParam(i));
     }
     return RetVal();
 }
 
-RetVal FuncFParamAST::Dump() const
+RetVal FuncFParamAST::Dump(CompileContext &ctx) const
 {
+    if (btype != "int")
+        assert(0);
+
     if (derive_type == NUMBER)
     {
-        koopa_ret_str += "@" + ident;
-        if (btype == "int")
-            koopa_ret_str += ": i32";
-        else
-            assert(0);
+        ctx.ir_builder.addParam("@" + string(ident), ctx.ir_builder.int32Type());
         return RetVal();
     }
-    koopa_ret_str += "@" + ident + ": *";
-    string res;
-    if (btype == "int")
-        res += "i32";
-    else
-        assert(0);
+
+    vector<int> shape;
     for (auto &constexp : constexps)
     {
-        res = "[" + res + ", " + to_string(constexp->Cal()) + "]";
+        shape.push_back(constexp->Cal(ctx));
     }
-    koopa_ret_str += res;
+    ctx.ir_builder.addParam("@" + string(ident), ctx.ir_builder.pointerType(_array_type(ctx, shape)));
     return RetVal();
 }
 
-RetVal FuncFParamAST::Alloc() const
+RetVal FuncFParamAST::Alloc(CompileContext &ctx, koopa_raw_value_t param) const
 {
     if (derive_type == NUMBER)
     {
-        koopa_ret_str += "\t@" + ident + "_" + to_string(cur_scope) + " = alloc i32\n";
+        koopa_raw_value_t addr = ctx.ir_builder.alloc("@" + string(ident) + "_" + to_string(ctx.cur_scope), ctx.ir_builder.int32Type());
 
-        koopa_ret_str += "\tstore @" + ident + ", @" + ident + "_" + to_string(cur_scope) + "\n";
+        ctx.ir_builder.store(param, addr);
 
-        symbol_table.insert(ident, 0, _VAR, _INT);
+        ctx.symbol_table.insert(ident, 0, _VAR, _INT);
     }
     else
     {
@@ -419,912 +300,529 @@ RetVal FuncFParamAST::Alloc() const
 
         for (auto &constexp : constexps)
         {
-            origin_shape.push_back(constexp->Cal());
+            origin_shape.push_back(constexp->Cal(ctx));
         }
 
         for (int l : origin_shape)
             padding_shape.push_back(l);
 
-        string name = symbol_table.insert(ident, padding_shape, VAR_ARRAY, _INT);
-
-        string res = "i32";
-        for (int i = origin_shape.size() - 1; i >= 0; --i)
-        {
-            res = "[" + res + ", " + to_string(origin_shape[i]) + "]";
-        }
+        string name = ctx.symbol_table.insert(ident, padding_shape, VAR_ARRAY, _INT);
 
-        koopa_ret_str += " \t@" + name + " = alloc *" + res + "\n";
-        koopa_ret_str += "\tstore @" + ident + ", @" + name + "\n";
+        koopa_raw_value_t addr = ctx.ir_builder.alloc("@" + name, ctx.ir_builder.pointerType(_array_type(ctx, origin_shape)));
+        ctx.ir_builder.store(param, addr);
     }
 
     return RetVal();
 }
 
-RetVal BlockAST::Dump() const
+RetVal BlockAST::Dump(CompileContext &ctx) const
 {
-    bool common = symbol_table.inc();
-    cerr << "//! block begin, cur_scope: " << cur_scope << endl;
+    bool common = ctx.symbol_table.inc();
+    cerr << "//! block begin, ctx.cur_scope: " << ctx.cur_scope << endl;
     if (!common)
     {
-        scope_parent[symbol_table.getDepLabelNo()] = cur_scope;
-        cur_scope = symbol_table.getDepLabelNo();
+        ctx.scope_parent[ctx.symbol_table.getDepLabelNo()] = ctx.cur_scope;
+        ctx.cur_scope = ctx.symbol_table.getDepLabelNo();
     }
 
-    is_end[cur_basic_block] = false;
+    ctx.is_end[ctx.cur_basic_block] = false;
     for (auto &blockitem : blockitems)
-        blockitem->Dump();
-    symbol_table.dec();
-    cur_scope = scope_parent[cur_scope];
-    cerr << "//! block end, cur_scope: " << cur_scope << endl;
+        blockitem->Dump(ctx);
+    ctx.symbol_table.dec();
+    ctx.cur_scope = ctx.scope_parent[ctx.cur_scope];
+    cerr << "//! block end, ctx.cur_scope: " << ctx.cur_scope << endl;
     return RetVal();
 }
 
-RetVal BlockItemAST::Dump() const
+RetVal BlockItemAST::Dump(CompileContext &ctx) const
 {
-    if (is_end[cur_basic_block])
+    if (ctx.is_end[ctx.cur_basic_block])
         return RetVal();
-    return ds->Dump();
+    return ds->Dump(ctx);
 }
 
-RetVal StmtAST::Dump() const
+RetVal StmtAST::Dump(CompileContext &ctx) const
 {
     if (derive_type == ASSIGN)
     {
-        string name = lval->Dump().getStr();
+        koopa_raw_value_t dest = lval->Dump(ctx).getPtr();
 
-        RetVal ret_val = rexpr->Dump();
+        RetVal ret_val = rexpr->Dump(ctx);
 
-        if (ret_val.isNumber())
-        {
-            koopa_ret_str += "\tstore " + to_string(ret_val.getVal()) + ", " + name + "\n";
-        }
-        else
-        {
-            koopa_ret_str += "\tstore %" + to_string(sym_no - 1) + ", " + name + "\n";
-        }
+        ctx.ir_builder.store(ret_val.getValue(ctx.ir_builder), dest);
 
         return RetVal();
     }
     else if (derive_type == RETURN)
     {
-        if (is_end[cur_basic_block])
+        if (ctx.is_end[ctx.cur_basic_block])
             return RetVal();
 
         if (expr)
         {
-            RetVal ret_val = (*expr)->Dump();
-            // symbol_table.debug();
-            if (ret_val.isNumber())
-            {
-                koopa_ret_str += "\tret " + to_string(ret_val.getVal()) + "\n";
-            }
-            else
-            {
-
-                koopa_ret_str += "\tret %" + to_string(sym_no - 1) + "\n";
-            }
+            RetVal ret_val = expr->Dump(ctx);
+            ctx.ir_builder.ret(ret_val.getValue(ctx.ir_builder));
         }
         else
         {
-            if (cur_func_type == "void")
-                koopa_ret_str += "\tret\n";
-            else if (cur_func_type == "int")
-                koopa_ret_str += "\tret 0\n";
+            if (ctx.cur_func_type == "void")
+                ctx.ir_builder.ret(nullptr);
+            else if (ctx.cur_func_type == "int")
+                ctx.ir_builder.ret(ctx.ir_builder.integer(0));
             else
                 assert(0);
         }
-        is_end[cur_basic_block] = true;
+        ctx.is_end[ctx.cur_basic_block] = true;
         return RetVal();
     }
     else if (derive_type == EXPR)
     {
         if (expr)
-            (*expr)->Dump();
+            expr->Dump(ctx);
         return RetVal();
     }
     else
     {
-        return block->Dump();
+        return block->Dump(ctx);
     }
     return RetVal();
 }
 
-RetVal IfStmtAST::Dump() const
+RetVal IfStmtAST::Dump(CompileContext &ctx) const
 {
-    if (is_end[cur_basic_block])
+    if (ctx.is_end[ctx.cur_basic_block])
         return RetVal();
 
-    int cur_if_label_no = if_label_no;
-    if_label_no++;
+    int cur_if_label_no = ctx.if_label_no;
+    ctx.if_label_no++;
 
-    RetVal ret_val = expr->Dump();
+    koopa_raw_basic_block_t then_bb = ctx.ir_builder.newBlock("%then_" + to_string(cur_if_label_no));
+    koopa_raw_basic_block_t else_bb = nullptr;
+    koopa_raw_basic_block_t end_bb = ctx.ir_builder.newBlock("%end_" + to_string(cur_if_label_no));
 
-    if (ret_val.isNumber())
-    {
-        koopa_ret_str += "\tbr " + to_string(ret_val.getVal()) + ", %then_" + to_string(cur_if_label_no);
-        if (derive_type == NOELSE)
-            koopa_ret_str += ", %end_";
-        else
-            koopa_ret_str += ", %else_";
-        koopa_ret_str += to_string(cur_if_label_no) + "\n";
-    }
+    if (derive_type == NOELSE)
+        expr->Cond(ctx, then_bb, end_bb);
     else
     {
-        koopa_ret_str += "\tbr %" + to_string(sym_no - 1) + ", %then_" + to_string(cur_if_label_no);
-        if (derive_type == NOELSE)
-            koopa_ret_str += ", %end_";
-        else
-            koopa_ret_str += ", %else_";
-        koopa_ret_str += to_string(cur_if_label_no) + "\n";
+        else_bb = ctx.ir_builder.newBlock("%else_" + to_string(cur_if_label_no));
+        expr->Cond(ctx, then_bb, else_bb);
     }
 
-    koopa_ret_str += "\n%then_" + to_string(cur_if_label_no) + ":\n";
+    ctx.ir_builder.setBlock(then_bb);
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
-    ifstmt->Dump();
-    if (!is_end[cur_basic_block])
-        koopa_ret_str += "\tjump %end_" + to_string(cur_if_label_no) + "\n";
+    ifstmt->Dump(ctx);
+    if (!ctx.is_end[ctx.cur_basic_block])
+        ctx.ir_builder.jump(end_bb);
 
     if (derive_type == ELSE)
     {
-        cur_basic_block++;
-        is_end[cur_basic_block] = false;
+        ctx.cur_basic_block++;
+        ctx.is_end[ctx.cur_basic_block] = false;
 
-        koopa_ret_str += "\n%else_" + to_string(cur_if_label_no) + ":\n";
-        elsestmt->Dump();
+        ctx.ir_builder.setBlock(else_bb);
+        elsestmt->Dump(ctx);
 
-        if (!is_end[cur_basic_block])
-            koopa_ret_str += "\tjump %end_" + to_string(cur_if_label_no) + "\n";
+        if (!ctx.is_end[ctx.cur_basic_block])
+            ctx.ir_builder.jump(end_bb);
     }
 
-    koopa_ret_str += "\n%end_" + to_string(cur_if_label_no) + ":\n";
+    ctx.ir_builder.setBlock(end_bb);
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
     return RetVal();
 }
 
-RetVal WhileStmtAST::Dump() const
+// 循环被旋转成有保护的 do-while:
+// 进入循环前判断一次条件, 循环体之后的 %while_cond_N 再判断一次并跳回循环体,
+// 每次迭代只执行一条向回跳的条件跳转;
+RetVal WhileStmtAST::Dump(CompileContext &ctx) const
 {
 
-    while_label_no++;
+    ctx.while_label_no++;
 
-    while_parent[while_label_no] = cur_while_level;
+    ctx.while_parent[ctx.while_label_no] = ctx.cur_while_level;
 
-    cur_while_level = while_label_no;
+    ctx.cur_while_level = ctx.while_label_no;
 
-    if (!is_end[cur_basic_block])
-        koopa_ret_str += "\tjump %while_entry_" + to_string(cur_while_level) + "\n";
+    koopa_raw_basic_block_t body_bb = ctx.ir_builder.newBlock("%while_body_" + to_string(ctx.cur_while_level));
+    koopa_raw_basic_block_t cond_bb = ctx.ir_builder.newBlock("%while_cond_" + to_string(ctx.cur_while_level));
+    koopa_raw_basic_block_t end_bb = ctx.ir_builder.newBlock("%while_end_" + to_string(ctx.cur_while_level));
+    ctx.while_cond_bb[ctx.cur_while_level] = cond_bb;
+    ctx.while_end_bb[ctx.cur_while_level] = end_bb;
 
-    koopa_ret_str += "\n%while_entry_" + to_string(cur_while_level) + ":\n";
+    // 当前基本块已经结束时, 循环不可达, 入口的判断放在单独的基本块中;
+    if (ctx.is_end[ctx.cur_basic_block])
+    {
+        ctx.ir_builder.setBlock(ctx.ir_builder.newBlock("%while_entry_" + to_string(ctx.cur_while_level)));
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+        ctx.cur_basic_block++;
+        ctx.is_end[ctx.cur_basic_block] = false;
+    }
 
-    RetVal ret_val = expr->Dump();
+    expr->Cond(ctx, body_bb, end_bb);
 
-    if (ret_val.isNumber())
-    {
-        koopa_ret_str += "\tbr " + to_string(ret_val.getVal()) + ", %while_body_" + to_string(cur_while_level);
+    ctx.ir_builder.setBlock(body_bb);
 
-        koopa_ret_str += ", %while_end_";
-        koopa_ret_str += to_string(cur_while_level) + "\n";
-    }
-    else
-    {
-        koopa_ret_str += "\tbr %" + to_string(sym_no - 1) + ", %while_body_" + to_string(cur_while_level);
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
-        koopa_ret_str += ", %while_end_";
-        koopa_ret_str += to_string(cur_while_level) + "\n";
-    }
+    whilestmt->Dump(ctx);
 
-    koopa_ret_str += "\n%while_body_" + to_string(cur_while_level) + ":\n";
+    if (!ctx.is_end[ctx.cur_basic_block])
+        ctx.ir_builder.jump(cond_bb);
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+    ctx.ir_builder.setBlock(cond_bb);
 
-    whilestmt->Dump();
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
-    if (!is_end[cur_basic_block])
-        koopa_ret_str += "\tjump %while_entry_" + to_string(cur_while_level) + "\n";
+    expr->Cond(ctx, body_bb, end_bb);
 
-    koopa_ret_str += "\n%while_end_" + to_string(cur_while_level) + ":\n";
+    ctx.ir_builder.setBlock(end_bb);
 
-    cur_basic_block++;
-    is_end[cur_basic_block] = false;
+    ctx.cur_basic_block++;
+    ctx.is_end[ctx.cur_basic_block] = false;
 
-    cur_while_level = while_parent[cur_while_level];
+    ctx.cur_while_level = ctx.while_parent[ctx.cur_while_level];
 
     return RetVal();
 }
 
-RetVal BrConStmtAST::Dump() const
+RetVal BrConStmtAST::Dump(CompileContext &ctx) const
 {
-    if (is_end[cur_basic_block])
+    if (ctx.is_end[ctx.cur_basic_block])
         return RetVal();
 
     if (derive_type == BREAK)
     {
-        koopa_ret_str += "\tjump %while_end_" + to_string(cur_while_level) + "\n";
+        ctx.ir_builder.jump(ctx.while_end_bb[ctx.cur_while_level]);
     }
     else
     {
-        koopa_ret_str += "\tjump %while_entry_" + to_string(cur_while_level) + "\n";
+        // continue 跳到循环底部的条件判断;
+        ctx.ir_builder.jump(ctx.while_cond_bb[ctx.cur_while_level]);
     }
 
-    is_end[cur_basic_block] = true;
+    ctx.is_end[ctx.cur_basic_block] = true;
 
     return RetVal();
 }
 
-RetVal ExprAST::Dump() const
+void BaseAST::Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const
+{
+    RetVal ret_val = Dump(ctx);
+    ctx.ir_builder.branch(ret_val.getValue(ctx.ir_builder), true_bb, false_bb);
+}
+
+RetVal NumberExpAST::Dump(CompileContext &ctx) const
+{
+    return RetVal(number);
+}
+
+RetVal UnaryExpAST::Dump(CompileContext &ctx) const
 {
-    return lorexp->Dump();
+    RetVal ret_val = exp->Dump(ctx);
+    if (op == OP_POS)
+        return ret_val;
+    else if (op == OP_NEG)
+        return RetVal(ctx.ir_builder.binary(KOOPA_RBO_SUB, ctx.ir_builder.integer(0), ret_val.getValue(ctx.ir_builder)));
+    else if (op == OP_NOT)
+        return RetVal(ctx.ir_builder.binary(KOOPA_RBO_EQ, ctx.ir_builder.integer(0), ret_val.getValue(ctx.ir_builder)));
+    assert(0);
+    return RetVal();
 }
 
-RetVal UnaryExpAST::Dump() const
+void UnaryExpAST::Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const
 {
-    if (derive_type == PRIMARYEXP)
-        return primaryexp->Dump();
+    if (op == OP_NOT)
+        exp->Cond(ctx, false_bb, true_bb);
     else
-    {
-        RetVal ret_val = unaryexp->Dump();
-        if (ret_val.isNumber())
-        {
-            if (op == "!")
-            {
-                koopa_ret_str += ("\t%" + to_string(sym_no) + " = eq 0, " + to_string(ret_val.getVal()) + "\n");
-                sym_no++;
-                return RetVal();
-            }
-            else if (op == "-")
-            {
-                koopa_ret_str += ("\t%" + to_string(sym_no) + " = sub 0, " + to_string(ret_val.getVal()) + "\n");
-                sym_no++;
-                return RetVal();
-            }
-            else if (op == "+")
-            {
-                return RetVal(ret_val.getVal());
-            }
-        }
-        else
-        {
-            if (op == "-")
-            {
-                koopa_ret_str += ("\t%" + to_string(sym_no) + " = " + "sub 0, %" + to_string(sym_no - 1) + "\n");
-                sym_no++;
-                return RetVal();
-            }
-            else if (op == "+")
-            {
-                return RetVal();
-            }
-            else if (op == "!")
-            {
-                koopa_ret_str += ("\t%" + to_string(sym_no) + " = " + "eq 0, %" + to_string(sym_no - 1) + "\n");
-                sym_no++;
-                return RetVal();
-            }
-        }
-        return RetVal();
-    }
+        exp->Cond(ctx, true_bb, false_bb);
 }
 
-RetVal FuncUnaryExpAST::Dump() const
+RetVal FuncUnaryExpAST::Dump(CompileContext &ctx) const
 {
     cerr << "//! func unary: " << ident << endl;
 
-    vector<string> params_s;
+    vector<const void *> params_v;
 
     if (params)
-        params_s = (*params)->Alloc();
+        params_v = params->Alloc(ctx);
 
-    Symbol func_s = symbol_table.getFromGlobal(ident);
+    const Symbol &func_s = ctx.symbol_table.getFromGlobal(ident);
 
     cerr << "//! get func symbol\n";
 
     assert(func_s.getSymbolType() == _FUNC);
-    if (func_s.getDataType() == _INT)
-    {
-        koopa_ret_str += "\t%" + to_string(sym_no) + " = call @" + func_s.getName() + "(";
-        sym_no++;
-    }
-    else
-    {
-        koopa_ret_str += "\tcall @" + func_s.getName() + "(";
-    }
-
-    bool first = true;
-    for (auto para : params_s)
-    {
-        if (!first)
-            koopa_ret_str += ", ";
-        koopa_ret_str += para;
-        first = false;
-    }
-
-    koopa_ret_str += ")\n";
 
-    return RetVal();
+    return RetVal(ctx.ir_builder.call(ctx.ir_builder.getFunc("@" + func_s.getName()), params_v));
 }
 
-RetVal FuncRParamsAST::Dump() const
+RetVal FuncRParamsAST::Dump(CompileContext &ctx) const
 {
     for (auto &param : funcrparams)
     {
-        param->Dump();
+        param->Dump(ctx);
     }
     return RetVal();
 }
 
-vector<string> FuncRParamsAST::Alloc() const
+vector<const void *> FuncRParamsAST::Alloc(CompileContext &ctx) const
 {
-    vector<string> ret_vec;
+    vector<const void *> ret_vec;
     for (auto &param : funcrparams)
     {
-        RetVal ret_val = param->Dump();
-        if (ret_val.isNumber())
-            ret_vec.push_back(to_string(ret_val.getVal()));
-        else
-        {
-            ret_vec.push_back("%" + to_string(sym_no - 1));
-        }
+        RetVal ret_val = param->Dump(ctx);
+        ret_vec.push_back(ret_val.getValue(ctx.ir_builder));
     }
     return ret_vec;
 }
 
-RetVal LValAST::Dump() const
+RetVal LValAST::Dump(CompileContext &ctx) const
+{
+    RetVal ret_val = Addr(ctx);
+    if (is_rval && ret_val.isPtr())
+        return RetVal(ctx.ir_builder.load(ret_val.getPtr()));
+    return ret_val;
+}
+
+RetVal LValAST::Addr(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
     {
-        Symbol lval_s = symbol_table.get(ident);
+        const Symbol &lval_s = ctx.symbol_table.get(ident);
         if (lval_s.isConst())
             return RetVal(lval_s.getVal());
         else if (lval_s.getSymbolType() == _VAR)
         {
-            return RetVal("@" + lval_s.getName());
+            return RetVal(ctx.ir_builder.getVar("@" + lval_s.getName()), true);
         }
         else
         {
+            koopa_raw_value_t addr = ctx.ir_builder.getVar("@" + lval_s.getName());
 
-            if (symbol_table.getArray(ident)[0] == -1)
-            {
-                koopa_ret_str += "\t%" + to_string(sym_no) + " = load @" + lval_s.getName() + "\n";
-                sym_no++;
-                return RetVal();
-            }
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = getelemptr @" + lval_s.getName() + ", 0\n";
-            sym_no++;
+            if (ctx.symbol_table.getArray(ident)[0] == -1)
+                return RetVal(ctx.ir_builder.load(addr));
 
-            return RetVal();
+            return RetVal(ctx.ir_builder.getElemPtr(addr, ctx.ir_builder.integer(0)));
         }
     }
     else
     {
-        vector<string> idx;
+        vector<koopa_raw_value_t> idx;
 
         for (auto &e : exprs)
         {
-            RetVal ret_val = e->Dump();
-            if (ret_val.isNumber())
-                idx.push_back(to_string(ret_val.getVal()));
-            else
-            {
-                idx.push_back("%" + to_string(sym_no - 1));
-            }
+            RetVal ret_val = e->Dump(ctx);
+            idx.push_back(ret_val.getValue(ctx.ir_builder));
         }
 
-        vector<int> shape = symbol_table.getArray(ident);
-        Symbol lval_s = symbol_table.get(ident);
+        const vector<int> &shape = ctx.symbol_table.getArray(ident);
+        const Symbol &lval_s = ctx.symbol_table.get(ident);
+        koopa_raw_value_t addr = ctx.ir_builder.getVar("@" + lval_s.getName());
 
         if (!shape.empty() && shape[0] == -1)
         {
-            vector<int> _shape(shape.begin() + 1, shape.end());
-
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = load @" + lval_s.getName() + "\n";
-            sym_no++;
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = getptr %" + to_string(sym_no - 1) + ", " + idx[0] + "\n";
-            sym_no++;
-            int i = 1;
-            int n = idx.size();
-            while (i < n)
-            {
-                koopa_ret_str += "\t%" + to_string(sym_no) + " = getelemptr %" + to_string(sym_no - 1) + ", " + idx[i] + "\n";
-                i++;
-                sym_no++;
-            }
+            addr = ctx.ir_builder.load(addr);
+            addr = ctx.ir_builder.getPtr(addr, idx[0]);
         }
         else
         {
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = getelemptr @" + lval_s.getName() + ", " + idx[0] + "\n";
-            sym_no++;
-            int i = 1;
-            int n = idx.size();
-            while (i < n)
-            {
-                koopa_ret_str += "\t%" + to_string(sym_no) + " = getelemptr %" + to_string(sym_no - 1) + ", " + idx[i] + "\n";
-                i++;
-                sym_no++;
-            }
-        }
-
-        if (idx.size() < shape.size())
-        {
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = getelemptr %" + to_string(sym_no - 1) + ", 0\n";
-            sym_no++;
-            return RetVal();
+            addr = ctx.ir_builder.getElemPtr(addr, idx[0]);
         }
-        return RetVal("%" + to_string(sym_no - 1));
-    }
-}
-
-RetVal PrimaryExpAST::Dump() const
-{
-    if (derive_type == EXPR)
-        return expr_lval->Dump();
-    else if (derive_type == LVAL)
-    {
-        RetVal lval_s = expr_lval->Dump();
-        if (lval_s.isStr())
+        int i = 1;
+        int n = idx.size();
+        while (i < n)
         {
-            koopa_ret_str += "\t%" + to_string(sym_no) + " = load " + lval_s.getStr() + "\n";
-            sym_no++;
+            addr = ctx.ir_builder.getElemPtr(addr, idx[i]);
+            i++;
         }
-        return lval_s;
-    }
-    else
-        return RetVal(number);
-}
-
-RetVal MulExpAST::Dump() const
-{
-    if (derive_type == UNARYEXP)
-        return unaryexp->Dump();
-    else
-    {
-        RetVal lret_val = mulexp->Dump();
-        int sno_l = sym_no - 1;
-
-        RetVal rret_val = unaryexp->Dump();
-        int sno_r = sym_no - 1;
 
-        assert(op == "*" || op == "/" || op == "%");
-
-        if (lret_val.isNumber() && rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_b(lret_val.getVal(), op, rret_val.getVal());
-            sym_no++;
-        }
-        else if (lret_val.isNumber())
-        {
-            koopa_ret_str += _generate_l(lret_val.getVal(), op, sno_r);
-            sym_no++;
-        }
-        else if (rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_r(sno_l, op, rret_val.getVal());
-            sym_no++;
-        }
-        else
-        {
-            koopa_ret_str += _generate_n(sno_l, op, sno_r);
-            sym_no++;
-        }
-        return RetVal();
-    }
-}
-
-RetVal AddExpAST::Dump() const
-{
-    if (derive_type == MULEXP)
-        return mulexp->Dump();
-    else
-    {
-        RetVal lret_val = addexp->Dump();
-        int sno_l = sym_no - 1;
-
-        RetVal rret_val = mulexp->Dump();
-        int sno_r = sym_no - 1;
-
-        assert(op == "+" || op == "-");
-
-        if (lret_val.isNumber() && rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_b(lret_val.getVal(), op, rret_val.getVal());
-            sym_no++;
-        }
-        else if (lret_val.isNumber())
-        {
-            koopa_ret_str += _generate_l(lret_val.getVal(), op, sno_r);
-            sym_no++;
-        }
-        else if (rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_r(sno_l, op, rret_val.getVal());
-            sym_no++;
-        }
-        else
-        {
-            koopa_ret_str += _generate_n(sno_l, op, sno_r);
-            sym_no++;
-        }
-        return RetVal();
-    }
-}
-
-RetVal RelExpAST::Dump() const
-{
-    if (derive_type == ADDEXP)
-        return addexp->Dump();
-    else
-    {
-        RetVal lret_val = relexp->Dump();
-        int sno_l = sym_no - 1;
-
-        RetVal rret_val = addexp->Dump();
-        int sno_r = sym_no - 1;
-
-        assert(op == "<" || op == ">" || op == "<=" || op == ">=");
-
-        if (lret_val.isNumber() && rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_b(lret_val.getVal(), op, rret_val.getVal());
-            sym_no++;
-        }
-        else if (lret_val.isNumber())
-        {
-            koopa_ret_str += _generate_l(lret_val.getVal(), op, sno_r);
-            sym_no++;
-        }
-        else if (rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_r(sno_l, op, rret_val.getVal());
-            sym_no++;
-        }
-        else
-        {
-            koopa_ret_str += _generate_n(sno_l, op, sno_r);
-            sym_no++;
-        }
-        return RetVal();
-    }
-}
-
-RetVal EqExpAST::Dump() const
-{
-    if (derive_type == RELEXP)
-        return relexp->Dump();
-    else
-    {
-        RetVal lret_val = eqexp->Dump();
-        int sno_l = sym_no - 1;
-
-        RetVal rret_val = relexp->Dump();
-        int sno_r = sym_no - 1;
-
-        assert(op == "==" || op == "!=");
-
-        if (lret_val.isNumber() && rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_b(lret_val.getVal(), op, rret_val.getVal());
-            sym_no++;
-        }
-        else if (lret_val.isNumber())
-        {
-            koopa_ret_str += _generate_l(lret_val.getVal(), op, sno_r);
-            sym_no++;
-        }
-        else if (rret_val.isNumber())
-        {
-            koopa_ret_str += _generate_r(sno_l, op, rret_val.getVal());
-            sym_no++;
-        }
-        else
+        if (idx.size() < shape.size())
         {
-            koopa_ret_str += _generate_n(sno_l, op, sno_r);
-            sym_no++;
+            return RetVal(ctx.ir_builder.getElemPtr(addr, ctx.ir_builder.integer(0)));
         }
-        return RetVal();
+        return RetVal(addr, true);
     }
 }
 
-RetVal LAndExpAST::Dump() const
+RetVal BinaryExpAST::Dump(CompileContext &ctx) const
 {
-    if (derive_type == EQEXP)
-        return eqexp->Dump();
-
-    int cur_if_label_no = if_label_no;
-    if_label_no++;
-
-    koopa_ret_str += "\t@landresult_" + to_string(cur_if_label_no) + " = alloc i32" + "\n";
-    koopa_ret_str += "\tstore 0, @landresult_" + to_string(cur_if_label_no) + "\n";
-
-    RetVal lret_val = landexp->Dump();
-    int sno_l = sym_no - 1;
-
-    if (lret_val.isNumber())
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, " + to_string(lret_val.getVal()) + "\n");
-        sym_no++;
-    }
-    else
+    if (op != OP_LAND && op != OP_LOR)
     {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, %" + to_string(sno_l) + "\n");
-        sym_no++;
-    }
-    koopa_ret_str += "\tbr %" + to_string(sym_no - 1) + ", %then_" + to_string(cur_if_label_no) + ", %end_" + to_string(cur_if_label_no) + "\n";
+        RetVal lret_val = lhs->Dump(ctx);
 
-    koopa_ret_str += "\n%then_" + to_string(cur_if_label_no) + ":\n"; // lhs==1, else lhs==0, result=0;
+        RetVal rret_val = rhs->Dump(ctx);
 
-    RetVal rret_val = eqexp->Dump();
-    int sno_r = sym_no - 1;
-
-    if (rret_val.isNumber())
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, " + to_string(rret_val.getVal()) + "\n");
-        sym_no++;
-    }
-    else
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, %" + to_string(sno_r) + "\n");
-        sym_no++;
+        return RetVal(_generate(ctx, op, lret_val, rret_val));
     }
 
-    koopa_ret_str += "\tstore %" + to_string(sym_no - 1) + ", @landresult_" + to_string(cur_if_label_no) + "\n"; // result=rhs;
+    // 只有需要整数结果时才把条件物化: 结果初始为 0, 条件成立时改为 1;
+    int cur_if_label_no = ctx.if_label_no;
+    ctx.if_label_no++;
 
-    koopa_ret_str += "\tjump %end_" + to_string(cur_if_label_no) + "\n";
+    string result_name = op == OP_LAND ? "@landresult_" : "@lorresult_";
+    koopa_raw_value_t result = ctx.ir_builder.alloc(result_name + to_string(cur_if_label_no), ctx.ir_builder.int32Type());
+    ctx.ir_builder.store(ctx.ir_builder.integer(0), result);
 
-    koopa_ret_str += "\n%end_" + to_string(cur_if_label_no) + ":\n";
+    koopa_raw_basic_block_t then_bb = ctx.ir_builder.newBlock("%then_" + to_string(cur_if_label_no));
+    koopa_raw_basic_block_t end_bb = ctx.ir_builder.newBlock("%end_" + to_string(cur_if_label_no));
+    Cond(ctx, then_bb, end_bb);
 
-    koopa_ret_str += "\t%" + to_string(sym_no) + " = load @landresult_" + to_string(cur_if_label_no) + "\n";
+    ctx.ir_builder.setBlock(then_bb);
+    ctx.ir_builder.store(ctx.ir_builder.integer(1), result);
+    ctx.ir_builder.jump(end_bb);
 
-    sym_no++;
+    ctx.ir_builder.setBlock(end_bb);
 
-    return RetVal();
+    return RetVal(ctx.ir_builder.load(result));
 }
 
-RetVal LOrExpAST::Dump() const
+void BinaryExpAST::Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const
 {
-    if (derive_type == LANDEXP)
-        return landexp->Dump();
-
-    int cur_if_label_no = if_label_no;
-    if_label_no++;
-
-    koopa_ret_str += "\t@lorresult_" + to_string(cur_if_label_no) + " = alloc i32" + "\n";
-    koopa_ret_str += "\tstore 1, @lorresult_" + to_string(cur_if_label_no) + "\n";
-
-    RetVal lret_val = lorexp->Dump();
-    int sno_l = sym_no - 1;
-
-    if (lret_val.isNumber())
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = eq 0, " + to_string(lret_val.getVal()) + "\n");
-        sym_no++;
-    }
-    else
+    if (op != OP_LAND && op != OP_LOR)
     {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = eq 0, %" + to_string(sno_l) + "\n");
-        sym_no++;
+        BaseAST::Cond(ctx, true_bb, false_bb);
+        return;
     }
 
-    koopa_ret_str += "\tbr %" + to_string(sym_no - 1) + ", %then_" + to_string(cur_if_label_no) + ", %end_" + to_string(cur_if_label_no) + "\n";
-
-    koopa_ret_str += "\n%then_" + to_string(cur_if_label_no) + ":\n"; // lhs=0, continue to rhs;
-
-    RetVal rret_val = landexp->Dump();
-    int sno_r = sym_no - 1;
+    // 短路求值: && 左边为 0 时直接跳到 false_bb, || 左边非 0 时直接跳到 true_bb, 否则在 rhs_bb 中继续判断右边;
+    int cur_if_label_no = ctx.if_label_no;
+    ctx.if_label_no++;
 
-    if (rret_val.isNumber())
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, " + to_string(rret_val.getVal()) + "\n");
-        sym_no++;
-    }
+    koopa_raw_basic_block_t rhs_bb = ctx.ir_builder.newBlock((op == OP_LAND ? "%land_rhs_" : "%lor_rhs_") + to_string(cur_if_label_no));
+    if (op == OP_LAND)
+        lhs->Cond(ctx, rhs_bb, false_bb);
     else
-    {
-        koopa_ret_str += ("\t%" + to_string(sym_no) + " = ne 0, %" + to_string(sno_r) + "\n");
-        sym_no++;
-    }
-
-    koopa_ret_str += "\tstore %" + to_string(sym_no - 1) + ", @lorresult_" + to_string(cur_if_label_no) + "\n"; // result=rhs;
-
-    koopa_ret_str += "\tjump %end_" + to_string(cur_if_label_no) + "\n";
+        lhs->Cond(ctx, true_bb, rhs_bb);
 
-    koopa_ret_str += "\n%end_" + to_string(cur_if_label_no) + ":\n";
-
-    koopa_ret_str += "\t%" + to_string(sym_no) + " = load @lorresult_" + to_string(cur_if_label_no) + "\n";
-
-    sym_no++;
-
-    return RetVal();
+    ctx.ir_builder.setBlock(rhs_bb);
+    rhs->Cond(ctx, true_bb, false_bb);
 }
 
-RetVal DeclAST::Dump() const
+RetVal DeclAST::Dump(CompileContext &ctx) const
 {
-    return cvdecl->Dump();
+    return cvdecl->Dump(ctx);
 }
 
-RetVal ConstDeclAST::Dump() const
+RetVal ConstDeclAST::Dump(CompileContext &ctx) const
 {
     for (auto &constdef : constdefs)
-        constdef->Dump();
+        constdef->Dump(ctx);
     return RetVal();
 }
 
-RetVal ConstDefAST::Dump() const
+RetVal ConstDefAST::Dump(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
     {
-        RetVal ret_val = constinitval->Dump();
-        symbol_table.insert(ident, ret_val.getVal(), _CONST, _INT);
+        RetVal ret_val = constinitval->Dump(ctx);
+        ctx.symbol_table.insert(ident, ret_val.getVal(), _CONST, _INT);
     }
     // printf("insert: %s, %d\n", ident.c_str(), ret_val.getVal());
-    // symbol_table.debug();
     else
     {
         vector<int> shape;
         for (auto &constexp : constexps)
         {
-            shape.push_back(constexp->Cal());
+            shape.push_back(constexp->Cal(ctx));
         }
 
-        string name = symbol_table.insert(ident, shape, CONST_ARRAY, _INT);
+        string name = ctx.symbol_table.insert(ident, shape, CONST_ARRAY, _INT);
 
-        if (cur_scope == 0)
+        if (ctx.cur_scope == 0)
         {
-            koopa_ret_str += "global @" + name + " = alloc ";
-
-            for (auto it = shape.begin(); it != shape.end(); it++)
-            {
-                koopa_ret_str += "[";
-            }
-            koopa_ret_str += "i32";
-            for (auto it = shape.rbegin(); it != shape.rend(); it++)
-            {
-                koopa_ret_str += ", " + to_string(*it) + "]";
-            }
-            koopa_ret_str += ", ";
-
-            auto vec = constinitval->Init(shape);
-            koopa_ret_str += getArrayInitVal(&vec, 0, shape);
-            koopa_ret_str += "\n";
+            SparseInit init;
+            constinitval->Init(arrayWidths(shape), 0, 0, init);
+            ctx.ir_builder.globalAlloc("@" + name, _array_type(ctx, shape), getArrayInitVal(ctx, init, shape));
         }
         else
         {
-            koopa_ret_str += "\t@" + name + " = alloc ";
-            for (auto it = shape.begin(); it != shape.end(); it++)
-            {
-                koopa_ret_str += "[";
-            }
-            koopa_ret_str += "i32";
-            for (auto it = shape.rbegin(); it != shape.rend(); it++)
-            {
-                koopa_ret_str += ", " + to_string(*it) + "]";
-            }
-            koopa_ret_str += "\n";
+            koopa_raw_value_t addr = ctx.ir_builder.alloc("@" + name, _array_type(ctx, shape));
 
-            auto vec = constinitval->Init(shape);
-            koopa_ret_str += localArrayInit("@" + name, &vec, 0, shape);
+            SparseInit init;
+            constinitval->Init(arrayWidths(shape), 0, 0, init);
+            vector<pair<int, koopa_raw_value_t>> vals;
+            for (auto &item : init)
+                vals.emplace_back(item.first, ctx.ir_builder.integer(item.second->Cal(ctx)));
+            localArrayInit(ctx, addr, vals, shape);
         }
     }
     return RetVal();
 }
 
-RetVal ConstInitValAST::Dump() const
+RetVal ConstInitValAST::Dump(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
     {
-        int val = constexp->Cal();
+        int val = constexp->Cal(ctx);
         return RetVal(val);
     }
     else
         return RetVal();
 }
 
-vector<int> ConstInitValAST::Init(vector<int> shape) const
+void ConstInitValAST::Init(const vector<int> &width, int dim, int base, SparseInit &out) const
 {
-    vector<int> vec;
-    int n = shape.size();
-
-    vector<int> width(shape);
-
-    for (int i = n - 2; i >= 0; --i)
-    {
-        width[i] *= width[i + 1];
-    }
-
     int pos = 0;
     for (auto &constinitval : constinitvals)
     {
+        if (pos >= width[dim])
+            break;
         if (constinitval->derive_type == NUMBER)
         {
-            vec.push_back(constinitval->Cal());
+            out.emplace_back(base + pos, constinitval->constexp);
             pos++;
         }
         else
         {
-            int i = 0;
-
-            if (pos)
-            {
-                for (i = n - 1; i >= 0; --i)
-                {
-                    if (pos % width[i])
-                        break;
-                }
-            }
-            ++i;
-
-            auto ret_vec = constinitval->Init(vector<int>(shape.begin() + i, shape.end()));
-            vec.insert(vec.end(), ret_vec.begin(), ret_vec.end());
-            int sz = vec.size();
-
+            // 花括号对应能与当前位置对齐的最大子数组;
+            int i = min(dim + 1, (int)width.size() - 1);
+            while (pos % width[i])
+                i++;
+            constinitval->Init(width, i, base + pos, out);
             pos += width[i];
-
-            int fill_cnt = pos - sz;
-            while (fill_cnt--)
-                vec.push_back(0);
-
-            assert(vec.size() == pos);
         }
-
-        if (pos >= width[0])
-            break;
-    }
-    for (; pos < width[0]; ++pos)
-    {
-        vec.push_back(0);
     }
-    return vec;
 }
 
-RetVal VarDeclAST::Dump() const
+RetVal VarDeclAST::Dump(CompileContext &ctx) const
 {
     for (auto &vardef : vardefs)
-        vardef->Dump();
+        vardef->Dump(ctx);
     return RetVal();
 }
 
-RetVal VarDefAST::Dump() const
+RetVal VarDefAST::Dump(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
     {
         cerr << "//! vardef: " << ident << endl;
-        string name = symbol_table.insert(ident, 0, _VAR, _INT);
-        if (cur_scope != 0)
+        string name = ctx.symbol_table.insert(ident, 0, _VAR, _INT);
+        if (ctx.cur_scope != 0)
         {
 
-            koopa_ret_str += "\t@" + name + " = alloc i32\n";
+            koopa_raw_value_t addr = ctx.ir_builder.alloc("@" + name, ctx.ir_builder.int32Type());
             if (initval)
             {
 
-                RetVal ret_val = (*initval)->Dump();
+                RetVal ret_val = initval->Dump(ctx);
 
-                if (ret_val.isNumber())
-                {
-                    koopa_ret_str += "\tstore " + to_string(ret_val.getVal()) + ", @" + name + "\n";
-                }
-                else
-                {
-                    koopa_ret_str += "\tstore %" + to_string(sym_no - 1) + ", @" + name + "\n";
-                }
+                ctx.ir_builder.store(ret_val.getValue(ctx.ir_builder), addr);
             }
         }
         else
         {
-            koopa_ret_str += "global @" + name + " = alloc i32, ";
-
+            // 全局变量的初值必须在编译期求出;
             if (initval)
-            {
-                RetVal ret_val = (*initval)->Dump();
-                koopa_ret_str += to_string(ret_val.getVal()) + "\n";
-            }
+                ctx.ir_builder.globalAlloc("@" + name, ctx.ir_builder.int32Type(), ctx.ir_builder.integer(initval->Cal(ctx)));
             else
-                koopa_ret_str += "zeroinit\n";
+                ctx.ir_builder.globalAlloc("@" + name, ctx.ir_builder.int32Type(), ctx.ir_builder.zeroInit(ctx.ir_builder.int32Type()));
         }
     }
     else
@@ -1333,253 +831,138 @@ RetVal VarDefAST::Dump() const
         vector<int> shape;
         for (auto &constexp : constexps)
         {
-            shape.push_back(constexp->Cal());
+            shape.push_back(constexp->Cal(ctx));
         }
 
-        string name = symbol_table.insert(ident, shape, VAR_ARRAY, _INT);
+        string name = ctx.symbol_table.insert(ident, shape, VAR_ARRAY, _INT);
 
-        if (cur_scope == 0)
+        if (ctx.cur_scope == 0)
         {
-            koopa_ret_str += "global @" + name + " = alloc ";
-
-            for (auto it = shape.begin(); it != shape.end(); it++)
-            {
-                koopa_ret_str += "[";
-            }
-            koopa_ret_str += "i32";
-            for (auto it = shape.rbegin(); it != shape.rend(); it++)
-            {
-                koopa_ret_str += ", " + to_string(*it) + "]";
-            }
-            koopa_ret_str += ", ";
             if (initval)
             {
-                auto vec = (*initval)->Init(shape);
-                koopa_ret_str += getArrayInitVal(&vec, 0, shape);
+                SparseInit init;
+                initval->Init(arrayWidths(shape), 0, 0, init);
+                ctx.ir_builder.globalAlloc("@" + name, _array_type(ctx, shape), getArrayInitVal(ctx, init, shape));
             }
             else
-                koopa_ret_str += "zeroinit";
-            koopa_ret_str += "\n";
+                ctx.ir_builder.globalAlloc("@" + name, _array_type(ctx, shape), ctx.ir_builder.zeroInit(_array_type(ctx, shape)));
         }
         else
         {
 
-            koopa_ret_str += "\t@" + name + " = alloc ";
-            for (auto it = shape.begin(); it != shape.end(); it++)
-            {
-                koopa_ret_str += "[";
-            }
-            koopa_ret_str += "i32";
-            for (auto it = shape.rbegin(); it != shape.rend(); it++)
-            {
-                koopa_ret_str += ", " + to_string(*it) + "]";
-            }
-            koopa_ret_str += "\n";
+            koopa_raw_value_t addr = ctx.ir_builder.alloc("@" + name, _array_type(ctx, shape));
 
             if (initval)
             {
-                auto vec = (*initval)->Init(shape);
-                for (auto ele : vec)
-                    cerr << ele << " ";
-                cerr << endl;
-                koopa_ret_str += localArrayInit("@" + name, &vec, 0, shape);
+                // 局部数组的初值可以是运行时的表达式, 按出现的顺序求值;
+                SparseInit init;
+                initval->Init(arrayWidths(shape), 0, 0, init);
+                vector<pair<int, koopa_raw_value_t>> vals;
+                for (auto &item : init)
+                    vals.emplace_back(item.first, item.second->Dump(ctx).getValue(ctx.ir_builder));
+                localArrayInit(ctx, addr, vals, shape);
             }
         }
     }
 
     return RetVal();
 }
-vector<int> InitValAST::Init(vector<int> shape) const
+void InitValAST::Init(const vector<int> &width, int dim, int base, SparseInit &out) const
 {
-    vector<int> vec;
-    int n = shape.size();
-
-    vector<int> width(shape);
-
-    for (int i = n - 2; i >= 0; --i)
-    {
-        width[i] *= width[i + 1];
-    }
-
     int pos = 0;
     for (auto &initval : initvals)
     {
+        if (pos >= width[dim])
+            break;
         if (initval->derive_type == NUMBER)
         {
-            vec.push_back(initval->Cal());
+            out.emplace_back(base + pos, initval->expr);
             pos++;
         }
         else
         {
-            int i = 0;
-
-            if (pos)
-            {
-                for (i = n - 1; i >= 0; --i)
-                {
-                    if (pos % width[i])
-                        break;
-                }
-            }
-            ++i;
-
-            auto ret_vec = initval->Init(vector<int>(shape.begin() + i, shape.end()));
-            vec.insert(vec.end(), ret_vec.begin(), ret_vec.end());
-            int sz = vec.size();
-
+            // 花括号对应能与当前位置对齐的最大子数组;
+            int i = min(dim + 1, (int)width.size() - 1);
+            while (pos % width[i])
+                i++;
+            initval->Init(width, i, base + pos, out);
             pos += width[i];
-
-            int fill_cnt = pos - sz;
-            while (fill_cnt--)
-                vec.push_back(0);
-
-            assert(vec.size() == pos);
         }
-
-        if (pos >= width[0])
-            break;
-    }
-    for (; pos < width[0]; ++pos)
-    {
-        vec.push_back(0);
     }
-    return vec;
 }
 
-RetVal InitValAST::Dump() const
+RetVal InitValAST::Dump(CompileContext &ctx) const
 {
-    return expr->Dump();
+    return expr->Dump(ctx);
 }
 
-RetVal ConstExpAST::Dump() const
+int UnaryExpAST::Cal(CompileContext &ctx) const
 {
-    return expr->Dump();
+    if (op == OP_POS)
+        return exp->Cal(ctx);
+    else if (op == OP_NEG)
+        return -exp->Cal(ctx);
+    else
+        return !exp->Cal(ctx);
 }
 
-int ExprAST::Cal() const
+int LValAST::Cal(CompileContext &ctx) const
 {
-    cerr << "exprcal\n";
-    return lorexp->Cal();
+    return ctx.symbol_table.get(ident).getVal();
 }
 
-int UnaryExpAST::Cal() const
-{
-    cerr << "unarycal\n";
-    if (derive_type == PRIMARYEXP)
-        return primaryexp->Cal();
-
-    if (op == "+")
-        return unaryexp->Cal();
-    else if (op == "-")
-        return -unaryexp->Cal();
-    else
-        return !unaryexp->Cal();
-}
-int LValAST::Cal() const
+int BinaryExpAST::Cal(CompileContext &ctx) const
 {
-    cerr << "lvalcal\n";
-    return symbol_table.get(ident).getVal();
-}
+    int l = lhs->Cal(ctx);
+    // 短路求值;
+    if (op == OP_LAND)
+        return l && rhs->Cal(ctx);
+    if (op == OP_LOR)
+        return l || rhs->Cal(ctx);
 
-int PrimaryExpAST::Cal() const
-{
-    cerr << "primarycal\n";
-    if (derive_type == NUMBER)
+    int r = rhs->Cal(ctx);
+    switch (op)
     {
-        cerr << "pri num " << number << endl;
-        return number;
+    case OP_ADD:
+        return l + r;
+    case OP_SUB:
+        return l - r;
+    case OP_MUL:
+        return l * r;
+    case OP_DIV:
+        return l / r;
+    case OP_MOD:
+        return l % r;
+    case OP_LT:
+        return l < r;
+    case OP_GT:
+        return l > r;
+    case OP_LE:
+        return l <= r;
+    case OP_GE:
+        return l >= r;
+    case OP_EQ:
+        return l == r;
+    case OP_NE:
+        return l != r;
+    default:
+        assert(0);
     }
-    else
-        return expr_lval->Cal();
-}
-
-int MulExpAST::Cal() const
-{
-    cerr << "mulcal\n";
-    if (derive_type == UNARYEXP)
-        return unaryexp->Cal();
-
-    if (op == "*")
-        return mulexp->Cal() * unaryexp->Cal();
-    else if (op == "/")
-        return mulexp->Cal() / unaryexp->Cal();
-    else
-        return mulexp->Cal() % unaryexp->Cal();
-}
-
-int AddExpAST::Cal() const
-{
-    cerr << "addcal\n";
-    if (derive_type == MULEXP)
-        return mulexp->Cal();
-    if (op == "+")
-        return addexp->Cal() + mulexp->Cal();
-    else
-        return addexp->Cal() - mulexp->Cal();
-}
-
-int RelExpAST::Cal() const
-{
-    cerr << "relcal\n";
-    if (derive_type == ADDEXP)
-        return addexp->Cal();
-
-    if (op == "<")
-        return relexp->Cal() < addexp->Cal();
-    else if (op == ">")
-        return relexp->Cal() > addexp->Cal();
-    else if (op == "<=")
-        return relexp->Cal() <= addexp->Cal();
-    else
-        return relexp->Cal() >= addexp->Cal();
-}
-
-int EqExpAST::Cal() const
-{
-    cerr << "eqcal\n";
-    if (derive_type == RELEXP)
-        return relexp->Cal();
-
-    if (op == "==")
-        return eqexp->Cal() == relexp->Cal();
-    else
-        return eqexp->Cal() != relexp->Cal();
-}
-
-int LAndExpAST::Cal() const
-{
-    cerr << "landcal\n";
-    if (derive_type == EQEXP)
-        return eqexp->Cal();
-
-    return landexp->Cal() && eqexp->Cal();
+    return 0;
 }
 
-int LOrExpAST::Cal() const
-{
-    cerr << "lorcal\n";
-    if (derive_type == LANDEXP)
-        return landexp->Cal();
-
-    return lorexp->Cal() || landexp->Cal();
-}
-
-int ConstExpAST::Cal() const
-{
-    return expr->Cal();
-}
-int InitValAST::Cal() const
+int InitValAST::Cal(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
-        return expr->Cal();
+        return expr->Cal(ctx);
     else
         return 0;
 }
 
-int ConstInitValAST::Cal() const
+int ConstInitValAST::Cal(CompileContext &ctx) const
 {
     if (derive_type == NUMBER)
-        return constexp->Cal();
+        return constexp->Cal(ctx);
     else
         return 0;
 }
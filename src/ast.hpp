@@ -3,125 +3,56 @@
 #include <cassert>
 #include <cstdio>
 #include <iostream>
-#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include <optional>
+#include <algorithm>
+#include <string_view>
 #include <string.h>
+#include "arena.hpp"
+#include "context.hpp"
+#include "ir_builder.hpp"
+#include "symbol_table.hpp"
 
 using namespace std;
 
-extern string koopa_ret_str;
-extern int sym_no;
-
 class RetVal
 {
     bool is_number;
     int number;
-    bool is_str;
-    string str;
+    bool is_ptr; // 左值的地址, 使用前需要 load;
+    koopa_raw_value_t value;
 
 public:
-    RetVal() : is_number(false), number(0), is_str(false), str("") {}
-    RetVal(int n) : is_number(true), number(n), is_str(false), str("") {}
-    RetVal(string id) : is_number(false), number(0), is_str(true), str(id) {}
+    RetVal() : is_number(false), number(0), is_ptr(false), value(nullptr) {}
+    RetVal(int n) : is_number(true), number(n), is_ptr(false), value(nullptr) {}
+    RetVal(koopa_raw_value_t v, bool ptr = false) : is_number(false), number(0), is_ptr(ptr), value(v) {}
     bool isNumber() { return is_number; }
     int getVal()
     {
         assert(is_number);
         return number;
     }
-    bool isStr() { return is_str; }
-    string getStr()
+    bool isPtr() { return is_ptr; }
+    koopa_raw_value_t getPtr()
     {
-        assert(is_str);
-        return str;
+        assert(is_ptr);
+        return value;
     }
-};
-
-extern unordered_map<string, string> op2ir;
-
-enum SYM_TYPE
-{
-    _CONST,
-    _VAR,
-    _FUNC,
-    CONST_ARRAY,
-    VAR_ARRAY
-};
-enum DATA_TYPE
-{
-    _INT,
-    _VOID
-};
-
-class Symbol
-{
-    SYM_TYPE symbol_type;
-    DATA_TYPE data_type;
-    int val;
-    string name;
-
-public:
-    Symbol() : symbol_type(_CONST), data_type(_INT), val(0), name("") {}
-    Symbol(SYM_TYPE s_type, DATA_TYPE d_type, int v, string n) : symbol_type(s_type), data_type(d_type), val(v), name(n) {}
-    bool isConst() { return symbol_type == _CONST; }
-    SYM_TYPE getSymbolType() { return symbol_type; }
-    DATA_TYPE getDataType() { return data_type; }
-    int getVal() { return val; }
-    string getName() { return name; }
-};
-
-class SymbolTable
-{
-    unordered_map<string, Symbol> table;
-    bool for_alloc_param = false;
-    unordered_map<string, vector<int>> array_shape_table;
-
-public:
-    SymbolTable() : for_alloc_param(false) {}
-    SymbolTable(bool is_for_alloc) : for_alloc_param(is_for_alloc) {}
-    void insert(string id, int val, SYM_TYPE s_type, DATA_TYPE d_type, string name);
-    void insert(string id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type, string name);
-    bool exist(string id);
-    Symbol get(string id);
-    vector<int> getArray(string id);
-    void common() { for_alloc_param = false; }
-    bool forAllocParam() { return for_alloc_param; }
-
-    void debug()
+    // 作为操作数使用, 数字转换成 integer;
+    koopa_raw_value_t getValue(IRBuilder &ir_builder)
     {
-        cout << "Symbol Table:\n";
-        for (auto it : table)
-        {
-            cout << it.first << " " << it.second.getVal() << " " << it.second.getName() << endl;
-        }
+        if (is_number)
+            return ir_builder.integer(number);
+        assert(value && !is_ptr);
+        return value;
     }
 };
 
-class SymbolTableStack
-{
-private:
-    // 下一个可用的变量dep_label;
-    int dep_label_no = 0;
-    vector<SymbolTable> stk;
+extern const koopa_raw_binary_op_t op2ir[];
 
-public:
-    SymbolTableStack();
-    // 增加一个符号表;
-    bool inc();
-    // 删除一个符号表;
-    void dec();
-    void incParam();
-    string insert(string id, int val, SYM_TYPE s_type, DATA_TYPE d_type);
-    string insert(string id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type);
-    bool exist(string id);
-    Symbol get(string id);
-    vector<int> getArray(string id);
-    Symbol getFromGlobal(string id);
-    int getDepLabelNo() { return dep_label_no; }
-};
+// AST 节点, 标识符和节点列表都分配在 CompileContext 的 ast_arena 中, 生成 IR 后一次性释放;
+// 节点不持有需要析构的成员, 生成 IR 时的状态 (符号表, 各种编号等) 都在 CompileContext 中;
 
 // 所有 AST 的基类
 class BaseAST
@@ -130,16 +61,19 @@ public:
     int derive_type;
     virtual ~BaseAST() = default;
 
-    virtual RetVal Dump() const = 0;
+    virtual RetVal Dump(CompileContext &ctx) const = 0;
+
+    virtual int Cal(CompileContext &ctx) const = 0;
 
-    virtual int Cal() const = 0;
+    // 作为条件生成代码: 非 0 时跳到 true_bb, 否则跳到 false_bb, 结束后当前基本块已经终结;
+    virtual void Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const;
 };
 class StartSymbolAST : public BaseAST
 {
 public:
-    unique_ptr<BaseAST> compunit;
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    BaseAST *compunit = nullptr;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 // CompUnit 是 BaseAST
@@ -153,19 +87,18 @@ class CompUnitAST : public BaseAST
     };
 
 public:
-    // 用智能指针管理对象
-    optional<unique_ptr<BaseAST>> compunit;
-    unique_ptr<BaseAST> funcdef_decl;
-    CompUnitAST(unique_ptr<BaseAST> &c, unique_ptr<BaseAST> &_, int type) : funcdef_decl(move(_))
+    BaseAST *compunit = nullptr;
+    BaseAST *funcdef_decl = nullptr;
+    CompUnitAST(BaseAST *c, BaseAST *_, int type) : funcdef_decl(_)
     {
-        compunit = make_optional<unique_ptr<BaseAST>>(move(c));
+        compunit = c;
         if (type == 0)
             derive_type = FUNCDEF;
         else
             derive_type = DECL;
     }
 
-    CompUnitAST(unique_ptr<BaseAST> &_, int type) : funcdef_decl(move(_))
+    CompUnitAST(BaseAST *_, int type) : funcdef_decl(_)
     {
         if (type == 0)
             derive_type = FUNCDEF;
@@ -173,9 +106,9 @@ public:
             derive_type = DECL;
     }
 
-    RetVal Dump() const override;
+    RetVal Dump(CompileContext &ctx) const override;
 
-    int Cal() const override { return 0; }
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class FuncFParamsAST;
@@ -184,13 +117,13 @@ class FuncFParamsAST;
 class FuncDefAST : public BaseAST
 {
 public:
-    string functype;
-    string ident;
-    optional<unique_ptr<FuncFParamsAST>> params;
-    unique_ptr<BaseAST> block;
+    string_view functype;
+    string_view ident;
+    FuncFParamsAST *params = nullptr;
+    BaseAST *block = nullptr;
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class FuncFParamAST;
@@ -199,12 +132,12 @@ class FuncFParamsAST : public BaseAST
 {
 
 public:
-    vector<unique_ptr<FuncFParamAST>> funcfparams;
+    ArenaVec<FuncFParamAST *> funcfparams;
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 
-    RetVal Alloc() const;
+    RetVal Alloc(CompileContext &ctx) const;
 };
 
 class FuncFParamAST : public BaseAST
@@ -216,9 +149,9 @@ class FuncFParamAST : public BaseAST
     };
 
 public:
-    string btype;
-    string ident;
-    vector<unique_ptr<BaseAST>> constexps;
+    string_view btype;
+    string_view ident;
+    ArenaVec<BaseAST *> constexps;
 
     FuncFParamAST(int type)
     {
@@ -228,21 +161,21 @@ public:
             derive_type = ARRAY;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override
     {
         return 0;
     }
-    RetVal Alloc() const;
+    RetVal Alloc(CompileContext &ctx, koopa_raw_value_t param) const;
 };
 
 class BlockAST : public BaseAST
 {
 public:
-    vector<unique_ptr<BaseAST>> blockitems;
+    ArenaVec<BaseAST *> blockitems;
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class BlockItemAST : public BaseAST
@@ -254,9 +187,9 @@ class BlockItemAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> ds;
+    BaseAST *ds = nullptr;
 
-    BlockItemAST(unique_ptr<BaseAST> &_ds, bool is_decl) : ds(move(_ds))
+    BlockItemAST(BaseAST *_ds, bool is_decl) : ds(_ds)
     {
         if (is_decl)
             derive_type = DECL;
@@ -264,8 +197,8 @@ public:
             derive_type = STMT;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class LValAST : public BaseAST
@@ -277,8 +210,9 @@ class LValAST : public BaseAST
     };
 
 public:
-    string ident;
-    vector<unique_ptr<BaseAST>> exprs;
+    string_view ident;
+    ArenaVec<BaseAST *> exprs;
+    bool is_rval = false; // 出现在表达式中时, 需要 load 出值;
     LValAST(int type)
     {
         if (type == 0)
@@ -287,8 +221,10 @@ public:
             derive_type = ARRAY;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &ctx) const override;
+    // 左值的地址, 或者常量/数组参数对应的值;
+    RetVal Addr(CompileContext &ctx) const;
 };
 
 class StmtAST : public BaseAST
@@ -302,32 +238,31 @@ class StmtAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> lval;
-    unique_ptr<BaseAST> rexpr;
-    optional<unique_ptr<BaseAST>>
-        expr;
-    unique_ptr<BaseAST> block;
+    BaseAST *lval = nullptr;
+    BaseAST *rexpr = nullptr;
+    BaseAST *expr = nullptr;
+    BaseAST *block = nullptr;
 
-    StmtAST(unique_ptr<BaseAST> &_lval, unique_ptr<BaseAST> &_expr) : lval(move(_lval)), rexpr(move(_expr))
+    StmtAST(BaseAST *_lval, BaseAST *_expr) : lval(_lval), rexpr(_expr)
     {
         derive_type = ASSIGN;
     }
     // type: RETURN 1, EXPR 2, BLOCK 3
-    StmtAST(unique_ptr<BaseAST> &_, int type)
+    StmtAST(BaseAST *_, int type)
     {
         if (type == 1)
         {
-            expr = make_optional(move(_));
+            expr = _;
             derive_type = RETURN;
         }
         else if (type == 2)
         {
-            expr = make_optional(move(_));
+            expr = _;
             derive_type = EXPR;
         }
         else if (type == 3)
         {
-            block = move(_);
+            block = _;
             derive_type = BLOCK;
         }
         else
@@ -344,8 +279,8 @@ public:
             assert(0);
     }
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class IfStmtAST : public BaseAST
@@ -357,29 +292,29 @@ class IfStmtAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> expr;
-    unique_ptr<BaseAST> ifstmt;
-    unique_ptr<BaseAST> elsestmt;
+    BaseAST *expr = nullptr;
+    BaseAST *ifstmt = nullptr;
+    BaseAST *elsestmt = nullptr;
 
-    IfStmtAST(unique_ptr<BaseAST> &_expr, unique_ptr<BaseAST> &_if) : expr(move(_expr)), ifstmt(move(_if)) { derive_type = NOELSE; }
-    IfStmtAST(unique_ptr<BaseAST> &_expr, unique_ptr<BaseAST> &_if, unique_ptr<BaseAST> &_else) : expr(move(_expr)), ifstmt(move(_if)), elsestmt(move(_else)) { derive_type = ELSE; }
+    IfStmtAST(BaseAST *_expr, BaseAST *_if) : expr(_expr), ifstmt(_if) { derive_type = NOELSE; }
+    IfStmtAST(BaseAST *_expr, BaseAST *_if, BaseAST *_else) : expr(_expr), ifstmt(_if), elsestmt(_else) { derive_type = ELSE; }
 
-    RetVal Dump() const override;
+    RetVal Dump(CompileContext &ctx) const override;
 
-    int Cal() const override { return 0; }
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class WhileStmtAST : public BaseAST
 {
 public:
-    unique_ptr<BaseAST> expr;
-    unique_ptr<BaseAST> whilestmt;
+    BaseAST *expr = nullptr;
+    BaseAST *whilestmt = nullptr;
 
-    WhileStmtAST(unique_ptr<BaseAST> &_expr, unique_ptr<BaseAST> &_while) : expr(move(_expr)), whilestmt(move(_while)) {}
+    WhileStmtAST(BaseAST *_expr, BaseAST *_while) : expr(_expr), whilestmt(_while) {}
 
-    RetVal Dump() const override;
+    RetVal Dump(CompileContext &ctx) const override;
 
-    int Cal() const override { return 0; }
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class BrConStmtAST : public BaseAST
@@ -399,211 +334,94 @@ public:
             derive_type = CONTINUE;
     }
 
-    RetVal Dump() const override;
+    RetVal Dump(CompileContext &ctx) const override;
 
-    int Cal() const override { return 0; }
+    int Cal(CompileContext &) const override { return 0; }
 };
 
-class ExprAST : public BaseAST
+// 表达式的运算符, 二元运算符的顺序与 op2ir 一致;
+enum EXP_OP
 {
-public:
-    unique_ptr<BaseAST> lorexp;
-
-    RetVal Dump() const override;
-
-    int Cal() const override;
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_LT,
+    OP_GT,
+    OP_LE,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_LAND,
+    OP_LOR,
+    OP_POS,
+    OP_NEG,
+    OP_NOT
 };
 
-class UnaryExpAST : public BaseAST
+// 文法中的优先级层次 (LOrExp -> ... -> PrimaryExp) 只在解析时使用,
+// 只有一个子节点的产生式直接返回子节点, 不再生成单独的 AST 节点;
+class NumberExpAST : public BaseAST
 {
-    enum TYPE
-    {
-        PRIMARYEXP,
-        UNARYEXP
-    };
-
-public:
-    unique_ptr<BaseAST> primaryexp;
-    string op;
-    unique_ptr<BaseAST> unaryexp;
-
-    UnaryExpAST(unique_ptr<BaseAST> &primary) : primaryexp(move(primary)) { derive_type = PRIMARYEXP; }
-    UnaryExpAST(string *_op, unique_ptr<BaseAST> &unary) : op(*move(_op)), unaryexp(move(unary)) { derive_type = UNARYEXP; }
-
-    RetVal Dump() const override;
-    int Cal() const override;
-};
-
-class FuncRParamsAST;
-
-class FuncUnaryExpAST : public BaseAST
-{
-
-public:
-    string ident;
-    optional<unique_ptr<FuncRParamsAST>> params;
-    RetVal Dump() const override;
-
-    int Cal() const override { return 0; }
-};
-
-class FuncRParamsAST : public BaseAST
-{
-public:
-    vector<unique_ptr<BaseAST>> funcrparams;
-
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
-
-    vector<string> Alloc() const;
-};
-
-class PrimaryExpAST : public BaseAST
-{
-    enum TYPE
-    {
-        EXPR,
-        LVAL,
-        NUMBER
-    };
-
 public:
-    unique_ptr<BaseAST> expr_lval;
-
     int number;
 
-    PrimaryExpAST(unique_ptr<BaseAST> &_el, bool is_lval) : expr_lval(move(_el))
-    {
-        if (!is_lval)
-            derive_type = EXPR;
-        else
-            derive_type = LVAL;
-    }
-
-    PrimaryExpAST(int number) : number(number) { derive_type = NUMBER; }
-
-    RetVal Dump() const override;
-    int Cal() const override;
-};
-
-class MulExpAST : public BaseAST
-{
-    enum TYPE
-    {
-        UNARYEXP, // MulExp::= UnaryExp
-        MULEXP    // MulExp::= MulExp ("*" | "/" | "%") UnaryExp;
-    };
-
-public:
-    unique_ptr<BaseAST> mulexp;
-    string op;
-    unique_ptr<BaseAST> unaryexp;
+    NumberExpAST(int n) : number(n) {}
 
-    MulExpAST(unique_ptr<BaseAST> &unary) : unaryexp(move(unary)) { derive_type = UNARYEXP; }
-    MulExpAST(unique_ptr<BaseAST> &mul, string *_op, unique_ptr<BaseAST> &unary) : mulexp(move(mul)), op(*move(_op)), unaryexp(move(unary)) { derive_type = MULEXP; }
-
-    RetVal Dump() const override;
-    int Cal() const override;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return number; }
 };
 
-class AddExpAST : public BaseAST
+class UnaryExpAST : public BaseAST
 {
-    enum TYPE
-    {
-        MULEXP, // AddExp::= MulExp;
-        ADDEXP  // AddExp::= AddExp ("+" | "-") MulExp;
-    };
-
 public:
-    unique_ptr<BaseAST> addexp;
-    string op;
-    unique_ptr<BaseAST> mulexp;
+    EXP_OP op;
+    BaseAST *exp = nullptr;
 
-    AddExpAST(unique_ptr<BaseAST> &mul) : mulexp(move(mul)) { derive_type = MULEXP; }
-    AddExpAST(unique_ptr<BaseAST> &add, string *_op, unique_ptr<BaseAST> &mul) : addexp(move(add)), op(*move(_op)), mulexp(move(mul)) { derive_type = ADDEXP; }
+    UnaryExpAST(EXP_OP _op, BaseAST *_exp) : op(_op), exp(_exp) {}
 
-    RetVal Dump() const override;
-    int Cal() const override;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &ctx) const override;
+    void Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const override;
 };
 
-class RelExpAST : public BaseAST
+class BinaryExpAST : public BaseAST
 {
-    enum TYPE
-    {
-        ADDEXP, // RelExp::= AddExp;
-        RELEXP  // RelExp::= RelExp ("<" | ">" | "<=" | ">=") AddExp;
-    };
-
 public:
-    unique_ptr<BaseAST> relexp;
-    string op;
-    unique_ptr<BaseAST> addexp;
+    EXP_OP op;
+    BaseAST *lhs = nullptr;
+    BaseAST *rhs = nullptr;
 
-    RelExpAST(unique_ptr<BaseAST> &add) : addexp(move(add)) { derive_type = ADDEXP; }
-    RelExpAST(unique_ptr<BaseAST> &rel, string *_op, unique_ptr<BaseAST> &add) : relexp(move(rel)), op(*move(_op)), addexp(move(add)) { derive_type = RELEXP; }
+    BinaryExpAST(EXP_OP _op, BaseAST *l, BaseAST *r) : op(_op), lhs(l), rhs(r) {}
 
-    RetVal Dump() const override;
-    int Cal() const override;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &ctx) const override;
+    void Cond(CompileContext &ctx, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb) const override;
 };
 
-class EqExpAST : public BaseAST
-{
-    enum TYPE
-    {
-        RELEXP, // EqExp::= RelExp
-        EQEXP   // EqExp::= EqExp ("==" | "!=") RelExp;
-    };
-
-public:
-    unique_ptr<BaseAST> eqexp;
-    string op;
-    unique_ptr<BaseAST> relexp;
-
-    EqExpAST(unique_ptr<BaseAST> &rel) : relexp(move(rel)) { derive_type = RELEXP; }
-    EqExpAST(unique_ptr<BaseAST> &eq, string *_op, unique_ptr<BaseAST> &rel) : eqexp(move(eq)), op(*move(_op)), relexp(move(rel)) { derive_type = EQEXP; }
-
-    RetVal Dump() const override;
-    int Cal() const override;
-};
+class FuncRParamsAST;
 
-class LAndExpAST : public BaseAST
+class FuncUnaryExpAST : public BaseAST
 {
-    enum TYPE
-    {
-        EQEXP,  // LAndExp::= EqExp;
-        LANDEXP // LAndExp::= LAndExp "&&" EqExp;
-    };
 
 public:
-    unique_ptr<BaseAST> landexp;
-    string op;
-    unique_ptr<BaseAST> eqexp;
+    string_view ident;
+    FuncRParamsAST *params = nullptr;
+    RetVal Dump(CompileContext &ctx) const override;
 
-    LAndExpAST(unique_ptr<BaseAST> &eq) : eqexp(move(eq)) { derive_type = EQEXP; }
-    LAndExpAST(unique_ptr<BaseAST> &land, string *_op, unique_ptr<BaseAST> &eq) : landexp(move(land)), op(*move(_op)), eqexp(move(eq)) { derive_type = LANDEXP; }
-
-    RetVal Dump() const override;
-    int Cal() const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
-class LOrExpAST : public BaseAST
+class FuncRParamsAST : public BaseAST
 {
-    enum TYPE
-    {
-        LANDEXP, // LOrExp::= LAndExp;
-        LOREXP   // LOrExp::= LOrExp "||" LAndExp;
-    };
-
 public:
-    unique_ptr<BaseAST> lorexp;
-    string op;
-    unique_ptr<BaseAST> landexp;
+    ArenaVec<BaseAST *> funcrparams;
 
-    LOrExpAST(unique_ptr<BaseAST> &land) : landexp(move(land)) { derive_type = LANDEXP; }
-    LOrExpAST(unique_ptr<BaseAST> &lor, string *_op, unique_ptr<BaseAST> &land) : lorexp(move(lor)), op(*move(_op)), landexp(move(land)) { derive_type = LOREXP; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 
-    RetVal Dump() const override;
-    int Cal() const override;
+    vector<const void *> Alloc(CompileContext &ctx) const;
 };
 
 class DeclAST : public BaseAST
@@ -615,37 +433,37 @@ class DeclAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> cvdecl;
+    BaseAST *cvdecl = nullptr;
 
-    DeclAST(unique_ptr<BaseAST> &cv, bool is_const) : cvdecl(move(cv))
+    DeclAST(BaseAST *cv, bool is_const) : cvdecl(cv)
     {
         if (is_const)
             derive_type = CONSTDECL;
         else
             derive_type = VARDECL;
     }
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class ConstDeclAST : public BaseAST
 {
 public:
-    string btype;
-    vector<unique_ptr<BaseAST>> constdefs;
+    string_view btype;
+    ArenaVec<BaseAST *> constdefs;
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class VarDeclAST : public BaseAST
 {
 public:
-    string btype;
-    vector<unique_ptr<BaseAST>> vardefs;
+    string_view btype;
+    ArenaVec<BaseAST *> vardefs;
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class ConstInitValAST;
@@ -659,9 +477,9 @@ class ConstDefAST : public BaseAST
     };
 
 public:
-    string ident;
-    vector<unique_ptr<BaseAST>> constexps;
-    unique_ptr<ConstInitValAST> constinitval;
+    string_view ident;
+    ArenaVec<BaseAST *> constexps;
+    ConstInitValAST *constinitval = nullptr;
 
     ConstDefAST(int type)
     {
@@ -671,8 +489,8 @@ public:
             derive_type = ARRAY;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
 class InitValAST;
@@ -686,28 +504,34 @@ class VarDefAST : public BaseAST
     };
 
 public:
-    string ident;
-    vector<unique_ptr<BaseAST>> constexps;
-    optional<unique_ptr<InitValAST>> initval;
+    string_view ident;
+    ArenaVec<BaseAST *> constexps;
+    InitValAST *initval = nullptr;
 
-    VarDefAST(string *id, int type) : ident(*move(id))
+    VarDefAST(string_view id, int type) : ident(id)
     {
         if (type == 0)
             derive_type = NUMBER;
         else
             derive_type = ARRAY;
     }
-    VarDefAST(string *id, unique_ptr<InitValAST> &init, int type) : ident(*move(id)), initval(make_optional(move(init)))
+    VarDefAST(string_view id, InitValAST *init, int type) : ident(id), initval(init)
     {
         if (type == 0)
             derive_type = NUMBER;
         else
             derive_type = ARRAY;
     }
-    RetVal Dump() const override;
-    int Cal() const override { return 0; }
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &) const override { return 0; }
 };
 
+// 展平后的数组初值: 按偏移递增排列的 (元素偏移, 初值表达式), 没有列出的元素为 0;
+typedef vector<pair<int, BaseAST *>> SparseInit;
+
+// 每一维子数组的元素个数, 末尾多一项 1 表示单个元素;
+vector<int> arrayWidths(const vector<int> &shape);
+
 class ConstInitValAST : public BaseAST
 {
     enum TYPE
@@ -717,8 +541,8 @@ class ConstInitValAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> constexp;
-    vector<unique_ptr<ConstInitValAST>> constinitvals;
+    BaseAST *constexp = nullptr;
+    ArenaVec<ConstInitValAST *> constinitvals;
 
     ConstInitValAST(int type)
     {
@@ -729,9 +553,10 @@ public:
             derive_type = ARRAY;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override;
-    vector<int> Init(vector<int> shape) const;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &ctx) const override;
+    // 把以 base 为起点, 第 dim 维开始的子数组的初始化列表展平追加到 out, 代价与列出的元素个数成正比;
+    void Init(const vector<int> &width, int dim, int base, SparseInit &out) const;
 };
 
 class InitValAST : public BaseAST
@@ -743,8 +568,8 @@ class InitValAST : public BaseAST
     };
 
 public:
-    unique_ptr<BaseAST> expr;
-    vector<unique_ptr<InitValAST>> initvals;
+    BaseAST *expr = nullptr;
+    ArenaVec<InitValAST *> initvals;
 
     InitValAST(int type)
     {
@@ -755,16 +580,8 @@ public:
             derive_type = ARRAY;
     }
 
-    RetVal Dump() const override;
-    int Cal() const override;
-    vector<int> Init(vector<int> shape) const;
-};
-
-class ConstExpAST : public BaseAST
-{
-public:
-    unique_ptr<BaseAST> expr;
-
-    RetVal Dump() const override;
-    int Cal() const override;
+    RetVal Dump(CompileContext &ctx) const override;
+    int Cal(CompileContext &ctx) const override;
+    // 把以 base 为起点, 第 dim 维开始的子数组的初始化列表展平追加到 out, 代价与列出的元素个数成正比;
+    void Init(const vector<int> &width, int dim, int base, SparseInit &out) const;
 };
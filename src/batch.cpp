@@ -0,0 +1,148 @@
+#include "batch.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct BatchTask
+{
+    fs::path input, output;
+    double ms = 0; // 读入, 编译和写出的总时间;
+    bool ok = false;
+};
+
+// 收集输入文件和对应的输出路径, 按路径排序保证输出顺序稳定;
+static bool _collect(const BatchOptions &options, vector<BatchTask> &tasks)
+{
+    const char *ext = options.mode == MODE_KOOPA ? ".koopa" : ".s";
+    fs::path root(options.input), out_dir(options.out_dir);
+    error_code ec;
+    if (fs::is_directory(root, ec))
+    {
+        for (auto &entry : fs::recursive_directory_iterator(root, ec))
+        {
+            if (!entry.is_regular_file() || entry.path().extension() != ".sy")
+                continue;
+            BatchTask task;
+            task.input = entry.path();
+            task.output = out_dir / fs::relative(entry.path(), root).replace_extension(ext);
+            tasks.push_back(move(task));
+        }
+    }
+    else
+    {
+        ifstream manifest(root);
+        if (!manifest)
+            return false;
+        string line;
+        while (getline(manifest, line))
+        {
+            // 忽略空行, 行尾的 \r 和 # 开头的注释;
+            while (!line.empty() && isspace((unsigned char)line.back()))
+                line.pop_back();
+            if (line.empty() || line[0] == '#')
+                continue;
+            BatchTask task;
+            task.input = line;
+            task.output = out_dir / fs::path(line).filename().replace_extension(ext);
+            tasks.push_back(move(task));
+        }
+    }
+    if (ec)
+        return false;
+    sort(tasks.begin(), tasks.end(), [](const BatchTask &a, const BatchTask &b)
+         { return a.input < b.input; });
+    return true;
+}
+
+static bool _read_file(const fs::path &path, string &content)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    content.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+static void _run_task(const BatchOptions &options, BatchTask &task)
+{
+    auto start = chrono::steady_clock::now();
+    string source;
+    if (_read_file(task.input, source))
+    {
+        error_code ec;
+        fs::create_directories(task.output.parent_path(), ec);
+        int fd = ::open(task.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            CompileOptions compile_options;
+            compile_options.mode = options.mode;
+            compile_options.opt = options.opt;
+            task.ok = compile(source, compile_options, fd);
+            task.ok &= ::close(fd) == 0;
+        }
+    }
+    task.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// 最近秩法求分位数, latency 已排序;
+static double _percentile(const vector<double> &latency, double p)
+{
+    size_t rank = (size_t)(p / 100 * latency.size() + 0.999999);
+    return latency[min(max(rank, (size_t)1), latency.size()) - 1];
+}
+
+int runBatch(const BatchOptions &options)
+{
+    vector<BatchTask> tasks;
+    if (!_collect(options, tasks))
+    {
+        printf("batch: cannot read %s\n", options.input.c_str());
+        return 1;
+    }
+
+    // 编译过程中的调试输出在多线程下交错在一起没有意义, 而且会成为瓶颈;
+    cerr.setstate(ios::badbit);
+
+    auto start = chrono::steady_clock::now();
+    size_t threads;
+    {
+        ThreadPool pool(max(options.jobs, 0));
+        threads = pool.size();
+        for (auto &task : tasks)
+            pool.submit([&options, &task]
+                        { _run_task(options, task); });
+        pool.wait();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr.clear();
+
+    int failed = 0;
+    vector<double> latency;
+    for (auto &task : tasks)
+    {
+        latency.push_back(task.ms);
+        if (!task.ok)
+        {
+            printf("FAIL %s\n", task.input.c_str());
+            failed++;
+        }
+    }
+    sort(latency.begin(), latency.end());
+
+    printf("batch: %zu files, %d failed, %zu threads, %.3f s, %.1f files/s\n",
+           tasks.size(), failed, threads, seconds, seconds > 0 ? tasks.size() / seconds : 0.0);
+    if (!latency.empty())
+        printf("latency (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+               _percentile(latency, 50), _percentile(latency, 90), _percentile(latency, 99), latency.back());
+    return failed;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "compiler.hpp"
+#include <string>
+
+using namespace std;
+
+// 批量编译: 输入是一个目录 (其中所有的 .sy 文件, 包括子目录) 或一个清单文件 (每行一个源文件路径);
+// 每个文件是线程池中的一个任务, 在工作线程上独立调用 compile(), 直接写出自己的输出文件;
+// 输出文件放在 out_dir 下, 目录输入保留相对路径, 清单输入只取文件名, 后缀换成 .koopa 或 .s;
+struct BatchOptions
+{
+    string input;
+    string out_dir;
+    CompileMode mode = MODE_RISCV;
+    int opt = 0;
+    int jobs = 0; // 0 或负数表示使用硬件线程数;
+};
+
+// 编译结束后在标准输出打印吞吐量 (文件/秒) 和单个文件延迟的分位数;
+// 返回编译失败的文件数, FAIL 只包括读写文件出错和语法错误;
+// 输入必须没有语义错误: 未定义或重复定义的符号等由 compile() 中的 assert 报告, 会终止整个进程,
+// 其他文件的结果和统计都不会输出, 需要先单独编译确认;
+int runBatch(const BatchOptions &options);
@@ -0,0 +1,241 @@
+#include "cfg.hpp"
+#include <algorithm>
+#include <cassert>
+
+static koopa_raw_value_t _slice_value(const koopa_raw_slice_t &slice, size_t i)
+{
+    return reinterpret_cast<koopa_raw_value_t>(slice.buffer[i]);
+}
+
+void getOperands(const koopa_raw_value_t &inst, vector<koopa_raw_value_t> &ops)
+{
+    ops.clear();
+    const auto &kind = inst->kind;
+    switch (kind.tag)
+    {
+    case KOOPA_RVT_LOAD:
+        ops.push_back(kind.data.load.src);
+        break;
+    case KOOPA_RVT_STORE:
+        ops.push_back(kind.data.store.value);
+        ops.push_back(kind.data.store.dest);
+        break;
+    case KOOPA_RVT_BINARY:
+        ops.push_back(kind.data.binary.lhs);
+        ops.push_back(kind.data.binary.rhs);
+        break;
+    case KOOPA_RVT_BRANCH:
+        ops.push_back(kind.data.branch.cond);
+        for (size_t i = 0; i < kind.data.branch.true_args.len; ++i)
+            ops.push_back(_slice_value(kind.data.branch.true_args, i));
+        for (size_t i = 0; i < kind.data.branch.false_args.len; ++i)
+            ops.push_back(_slice_value(kind.data.branch.false_args, i));
+        break;
+    case KOOPA_RVT_JUMP:
+        for (size_t i = 0; i < kind.data.jump.args.len; ++i)
+            ops.push_back(_slice_value(kind.data.jump.args, i));
+        break;
+    case KOOPA_RVT_RETURN:
+        if (kind.data.ret.value)
+            ops.push_back(kind.data.ret.value);
+        break;
+    case KOOPA_RVT_CALL:
+        for (size_t i = 0; i < kind.data.call.args.len; ++i)
+            ops.push_back(_slice_value(kind.data.call.args, i));
+        break;
+    case KOOPA_RVT_GET_ELEM_PTR:
+        ops.push_back(kind.data.get_elem_ptr.src);
+        ops.push_back(kind.data.get_elem_ptr.index);
+        break;
+    case KOOPA_RVT_GET_PTR:
+        ops.push_back(kind.data.get_ptr.src);
+        ops.push_back(kind.data.get_ptr.index);
+        break;
+    default:
+        break;
+    }
+}
+
+static void _replace_slice(koopa_raw_slice_t &slice, const function<koopa_raw_value_t(koopa_raw_value_t)> &f)
+{
+    for (size_t i = 0; i < slice.len; ++i)
+        slice.buffer[i] = f(_slice_value(slice, i));
+}
+
+void replaceOperands(const koopa_raw_value_t &inst, const function<koopa_raw_value_t(koopa_raw_value_t)> &f)
+{
+    auto &kind = const_cast<koopa_raw_value_data_t *>(inst)->kind;
+    switch (kind.tag)
+    {
+    case KOOPA_RVT_LOAD:
+        kind.data.load.src = f(kind.data.load.src);
+        break;
+    case KOOPA_RVT_STORE:
+        kind.data.store.value = f(kind.data.store.value);
+        kind.data.store.dest = f(kind.data.store.dest);
+        break;
+    case KOOPA_RVT_BINARY:
+        kind.data.binary.lhs = f(kind.data.binary.lhs);
+        kind.data.binary.rhs = f(kind.data.binary.rhs);
+        break;
+    case KOOPA_RVT_BRANCH:
+        kind.data.branch.cond = f(kind.data.branch.cond);
+        _replace_slice(kind.data.branch.true_args, f);
+        _replace_slice(kind.data.branch.false_args, f);
+        break;
+    case KOOPA_RVT_JUMP:
+        _replace_slice(kind.data.jump.args, f);
+        break;
+    case KOOPA_RVT_RETURN:
+        if (kind.data.ret.value)
+            kind.data.ret.value = f(kind.data.ret.value);
+        break;
+    case KOOPA_RVT_CALL:
+        _replace_slice(kind.data.call.args, f);
+        break;
+    case KOOPA_RVT_GET_ELEM_PTR:
+        kind.data.get_elem_ptr.src = f(kind.data.get_elem_ptr.src);
+        kind.data.get_elem_ptr.index = f(kind.data.get_elem_ptr.index);
+        break;
+    case KOOPA_RVT_GET_PTR:
+        kind.data.get_ptr.src = f(kind.data.get_ptr.src);
+        kind.data.get_ptr.index = f(kind.data.get_ptr.index);
+        break;
+    default:
+        break;
+    }
+}
+
+void getSuccessors(const koopa_raw_basic_block_t &bb, vector<koopa_raw_basic_block_t> &succs)
+{
+    succs.clear();
+    if (bb->insts.len == 0)
+        return;
+    auto last = _slice_value(bb->insts, bb->insts.len - 1);
+    if (last->kind.tag == KOOPA_RVT_BRANCH)
+    {
+        succs.push_back(last->kind.data.branch.true_bb);
+        succs.push_back(last->kind.data.branch.false_bb);
+    }
+    else if (last->kind.tag == KOOPA_RVT_JUMP)
+        succs.push_back(last->kind.data.jump.target);
+}
+
+CFG::CFG(const koopa_raw_function_t &func)
+{
+    size_t n = func->bbs.len;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        bb_id[bb] = i;
+        bbs.push_back(bb);
+    }
+
+    succs.resize(n);
+    preds.resize(n);
+    vector<koopa_raw_basic_block_t> targets;
+    for (size_t i = 0; i < n; ++i)
+    {
+        getSuccessors(bbs[i], targets);
+        for (auto t : targets)
+        {
+            int s = bb_id.at(t);
+            succs[i].push_back(s);
+            preds[s].push_back(i);
+        }
+    }
+
+    // 非递归 DFS 求后序, 长函数中基本块链很深;
+    rpo_num.assign(n, -1);
+    idom.assign(n, -1);
+    dom_children.resize(n);
+    df.resize(n);
+    if (!n)
+        return;
+    vector<bool> visited(n, false);
+    vector<pair<int, size_t>> stack{{0, 0}};
+    visited[0] = true;
+    while (!stack.empty())
+    {
+        auto &top = stack.back();
+        if (top.second < succs[top.first].size())
+        {
+            int s = succs[top.first][top.second++];
+            if (!visited[s])
+            {
+                visited[s] = true;
+                stack.emplace_back(s, 0);
+            }
+        }
+        else
+        {
+            rpo.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    reverse(rpo.begin(), rpo.end());
+    for (size_t i = 0; i < rpo.size(); ++i)
+        rpo_num[rpo[i]] = i;
+
+    // 沿逆后序迭代求直接支配者;
+    auto intersect = [&](int a, int b)
+    {
+        while (a != b)
+        {
+            while (rpo_num[a] > rpo_num[b])
+                a = idom[a];
+            while (rpo_num[b] > rpo_num[a])
+                b = idom[b];
+        }
+        return a;
+    };
+    idom[0] = 0;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); ++i)
+        {
+            int b = rpo[i];
+            int new_idom = -1;
+            for (auto p : preds[b])
+            {
+                if (idom[p] < 0)
+                    continue;
+                new_idom = new_idom < 0 ? p : intersect(p, new_idom);
+            }
+            if (new_idom != idom[b])
+            {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    for (size_t i = 1; i < rpo.size(); ++i)
+        dom_children[idom[rpo[i]]].push_back(rpo[i]);
+
+    // 汇合点的每个可达前驱沿支配树向上走到 idom, 途经的基本块的支配边界都包含汇合点;
+    for (auto b : rpo)
+    {
+        if (preds[b].size() < 2)
+            continue;
+        for (auto p : preds[b])
+        {
+            if (!reachable(p))
+                continue;
+            for (int runner = p; runner != idom[b]; runner = idom[runner])
+            {
+                if (df[runner].empty() || df[runner].back() != b)
+                    df[runner].push_back(b);
+            }
+        }
+    }
+}
+
+bool CFG::dominates(int a, int b) const
+{
+    assert(reachable(a) && reachable(b));
+    while (rpo_num[b] > rpo_num[a])
+        b = idom[b];
+    return a == b;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "koopa.h"
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// 指令的所有操作数, 包括 jump/branch 传给目标基本块的参数;
+void getOperands(const koopa_raw_value_t &inst, vector<koopa_raw_value_t> &ops);
+// 用 f 的返回值原地替换指令的每个操作数;
+void replaceOperands(const koopa_raw_value_t &inst, const function<koopa_raw_value_t(koopa_raw_value_t)> &f);
+// 基本块的后继;
+void getSuccessors(const koopa_raw_basic_block_t &bb, vector<koopa_raw_basic_block_t> &succs);
+
+// 数据流分析用的定长位集合;
+class BitSet
+{
+    vector<uint64_t> bits;
+
+public:
+    BitSet(size_t n = 0) : bits((n + 63) / 64, 0) {}
+    void set(size_t i) { bits[i / 64] |= (uint64_t)1 << (i % 64); }
+    void reset(size_t i) { bits[i / 64] &= ~((uint64_t)1 << (i % 64)); }
+    bool test(size_t i) const { return bits[i / 64] >> (i % 64) & 1; }
+    void unite(const BitSet &o)
+    {
+        for (size_t i = 0; i < bits.size(); ++i)
+            bits[i] |= o.bits[i];
+    }
+    // this = use | (out & ~def), 返回是否发生变化;
+    bool assignLiveIn(const BitSet &use, const BitSet &out, const BitSet &def)
+    {
+        bool changed = false;
+        for (size_t i = 0; i < bits.size(); ++i)
+        {
+            uint64_t v = use.bits[i] | (out.bits[i] & ~def.bits[i]);
+            changed |= v != bits[i];
+            bits[i] = v;
+        }
+        return changed;
+    }
+};
+
+// 函数的控制流图和支配树, 基本块按在函数中的顺序编号, 0 号是入口;
+// 支配树用 Cooper-Harvey-Kennedy 的迭代算法计算, 不可达的基本块 idom 为 -1;
+class CFG
+{
+public:
+    vector<koopa_raw_basic_block_t> bbs;
+    unordered_map<koopa_raw_basic_block_t, int> bb_id;
+    vector<vector<int>> succs, preds;
+    vector<int> rpo;      // 可达基本块的逆后序;
+    vector<int> rpo_num;  // 基本块在逆后序中的位置;
+    vector<int> idom;     // 直接支配者, 入口的 idom 是自己;
+    vector<vector<int>> dom_children;
+    vector<vector<int>> df; // 支配边界;
+
+    CFG(const koopa_raw_function_t &func);
+    bool reachable(int bb) const { return idom[bb] >= 0; }
+    bool dominates(int a, int b) const;
+};
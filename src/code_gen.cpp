@@ -1,11 +1,6 @@
 #include "code_gen.hpp"
 
-koopa_raw_function_t cur_func;
-
-int S, R, A;
-int S_;
-
-unordered_map<koopa_raw_binary_op_t, string> op2riscv{
+const unordered_map<koopa_raw_binary_op_t, string> op2riscv{
     /// Greater than.
     {KOOPA_RBO_GT, "sgt"},
     /// Less than.
@@ -27,11 +22,11 @@ unordered_map<koopa_raw_binary_op_t, string> op2riscv{
     /// Bitwise XOR.
     {KOOPA_RBO_XOR, "xor"},
     /// Shift left logical.
-    {KOOPA_RBO_SHL, "shl"},
+    {KOOPA_RBO_SHL, "sll"},
     /// Shift right logical.
-    {KOOPA_RBO_SHR, "shr"},
+    {KOOPA_RBO_SHR, "srl"},
     /// Shift right arithmetic.
-    {KOOPA_RBO_SAR, "sar"}};
+    {KOOPA_RBO_SAR, "sra"}};
 
 int _cal_size(koopa_raw_type_t ty)
 {
@@ -67,40 +62,395 @@ int VarTable::get(const koopa_raw_value_t &value)
     return table[value] + A; // 加上为传参预留的空间;
 }
 
-VarTable var_table;
+bool _is_imm12(long long imm)
+{
+    return imm >= -2048 && imm <= 2047;
+}
 
-void globalArrayInit(const koopa_raw_value_t &init)
+// 2 的幂次, 不是时返回 -1;
+int _log2(uint32_t c)
 {
-    if (init->kind.tag == KOOPA_RVT_INTEGER)
+    if (!c || (c & (c - 1)))
+        return -1;
+    int k = 0;
+    while (c >>= 1)
+        k++;
+    return k;
+}
+
+// 偏移量超出 12 位立即数范围时借助 t6 计算地址;
+void CodeGen::_load_stack(const string &reg, int offset)
+{
+    if (offset <= 2047 && offset >= -2048)
+        _inst("lw", reg, Mem(offset, "sp"));
+    else
+    {
+        _inst("li", "t6", offset);
+        _inst("add", "t6", "t6", "sp");
+        _inst("lw", reg, Mem(0, "t6"));
+    }
+}
+
+void CodeGen::_store_stack(const string &reg, int offset)
+{
+    if (offset <= 2047 && offset >= -2048)
+        _inst("sw", reg, Mem(offset, "sp"));
+    else
+    {
+        _inst("li", "t6", offset);
+        _inst("add", "t6", "t6", "sp");
+        _inst("sw", reg, Mem(0, "t6"));
+    }
+}
+
+// 取得操作数所在的寄存器, 不在寄存器中时先读到 tmp 中;
+string CodeGen::_load_value(const koopa_raw_value_t &value, const string &tmp)
+{
+    if (value->kind.tag == KOOPA_RVT_INTEGER)
+    {
+        if (value->kind.data.integer.value == 0)
+            return "x0";
+        _inst("li", tmp, value->kind.data.integer.value);
+        return tmp;
+    }
+    if (value->kind.tag == KOOPA_RVT_UNDEF)
+        return "x0";
+    // -O1 时函数参数在入口处被复制到自己的位置上;
+    if (value->kind.tag == KOOPA_RVT_FUNC_ARG_REF && !reg_alloc.inReg(value) && !var_table.exist(value))
+    {
+        size_t param_idx = value->kind.data.func_arg_ref.index;
+        if (param_idx < 8)
+            return "a" + to_string(param_idx);
+        _load_stack(tmp, (param_idx - 8) * 4 + S_); // 调用者栈帧中的参数;
+        return tmp;
+    }
+    if (reg_alloc.inReg(value))
+        return reg_alloc.getReg(value);
+    _load_stack(tmp, var_table.get(value));
+    return tmp;
+}
+
+// 取得指针指向的地址, alloc 和全局变量需要现场计算;
+string CodeGen::_load_addr(const koopa_raw_value_t &value, const string &tmp)
+{
+    int addr = 0;
+    switch (value->kind.tag)
+    {
+    case KOOPA_RVT_GLOBAL_ALLOC:
+        _inst("la", tmp, Label(value->name + 1));
+        return tmp;
+    case KOOPA_RVT_ALLOC:
+        addr = var_table.get(value);
+        if (addr <= 2047 && addr >= -2048)
+        {
+            _inst("addi", tmp, "sp", addr);
+        }
+        else
+        {
+            _inst("li", tmp, addr);
+            _inst("add", tmp, "sp", tmp);
+        }
+        return tmp;
+    default:
+        return _load_value(value, tmp);
+    }
+}
+
+// 指针 = 基址寄存器 + 常量偏移, 沿折叠的 getelemptr/getptr 链合并各维的下标;
+// 常量下标累加到偏移中, 变量下标乘以步长 (2 的幂次时移位) 后加到基址上;
+// self 为真时 ptr 本身也要展开, 用于计算 getelemptr/getptr 自己的结果;
+// 需要计算基址时使用 tmp, 变量下标借助 t2, t6;
+pair<string, int> CodeGen::_addr(const koopa_raw_value_t &ptr, const string &tmp, bool self)
+{
+    vector<pair<koopa_raw_value_t, int>> terms;
+    long long offset = 0;
+    koopa_raw_value_t v = ptr;
+    while (self || folded_addrs.count(v))
+    {
+        self = false;
+        koopa_raw_value_t index;
+        int stride;
+        if (v->kind.tag == KOOPA_RVT_GET_ELEM_PTR)
+        {
+            index = v->kind.data.get_elem_ptr.index;
+            v = v->kind.data.get_elem_ptr.src;
+            stride = _cal_size(v->ty->data.pointer.base->data.array.base);
+        }
+        else
+        {
+            assert(v->kind.tag == KOOPA_RVT_GET_PTR);
+            index = v->kind.data.get_ptr.index;
+            v = v->kind.data.get_ptr.src;
+            stride = _cal_size(v->ty->data.pointer.base);
+        }
+        if (index->kind.tag == KOOPA_RVT_INTEGER)
+            offset += (long long)index->kind.data.integer.value * stride;
+        else
+            terms.emplace_back(index, stride);
+    }
+
+    string base;
+    switch (v->kind.tag)
+    {
+    case KOOPA_RVT_ALLOC:
+        base = "sp";
+        offset += var_table.get(v);
+        break;
+    case KOOPA_RVT_GLOBAL_ALLOC:
+        _inst("la", tmp, Label(v->name + 1));
+        base = tmp;
+        break;
+    default:
+        base = _load_value(v, tmp);
+        break;
+    }
+
+    for (auto &term : terms)
+    {
+        string index = _load_value(term.first, "t2");
+        int k = _log2(term.second);
+        if (k < 0)
+        {
+            _inst("li", "t6", term.second);
+            _inst("mul", "t2", index, "t6");
+            index = "t2";
+        }
+        else if (k > 0)
+        {
+            _inst("slli", "t2", index, k);
+            index = "t2";
+        }
+        _inst("add", tmp, base, index);
+        base = tmp;
+    }
+
+    offset = (int32_t)offset;
+    if (!_is_imm12(offset))
+    {
+        _inst("li", "t6", offset);
+        _inst("add", tmp, base, "t6");
+        base = tmp;
+        offset = 0;
+    }
+    return {base, (int)offset};
+}
+
+// 指令结果应该写入的寄存器, 结果在栈上时先写到 tmp 中;
+string CodeGen::_dest_reg(const koopa_raw_value_t &value, const string &tmp)
+{
+    if (reg_alloc.inReg(value))
+        return reg_alloc.getReg(value);
+    return tmp;
+}
+
+// 把 reg 中的结果写回 value 的位置;
+void CodeGen::_save_value(const koopa_raw_value_t &value, const string &reg)
+{
+    if (reg_alloc.inReg(value))
+    {
+        string dest = reg_alloc.getReg(value);
+        if (dest != reg)
+            _inst("mv", dest, reg);
+    }
+    else
+        _store_stack(reg, var_table.get(value));
+}
+
+// value 所在的寄存器或栈位置, 常量和地址等不会被参数传递覆盖的值返回空串;
+string CodeGen::_location(const koopa_raw_value_t &value)
+{
+    if (value->kind.tag == KOOPA_RVT_ALLOC || value->kind.tag == KOOPA_RVT_GLOBAL_ALLOC)
+        return "";
+    if (reg_alloc.inReg(value))
+        return reg_alloc.getReg(value);
+    if (var_table.exist(value))
+        return to_string(var_table.get(value)) + "(sp)";
+    return "";
+}
+
+// 跳转前把实参并行地写入目标基本块的参数;
+// 先做目标不再被读取的赋值, 剩下的都在环上时把一个目标的旧值暂存到 t1;
+void CodeGen::_move_args(const koopa_raw_slice_t &args, const koopa_raw_basic_block_t &target)
+{
+    struct Move
+    {
+        koopa_raw_value_t dst, src;
+        string dst_loc, src_loc;
+    };
+    vector<Move> moves;
+    assert(args.len == target->params.len);
+    for (size_t i = 0; i < args.len; ++i)
+    {
+        auto dst = reinterpret_cast<koopa_raw_value_t>(target->params.buffer[i]);
+        auto src = reinterpret_cast<koopa_raw_value_t>(args.buffer[i]);
+        string dst_loc = _location(dst), src_loc = _location(src);
+        if (dst_loc != src_loc)
+            moves.push_back({dst, src, dst_loc, src_loc});
+    }
+
+    while (!moves.empty())
+    {
+        size_t i = 0;
+        for (; i < moves.size(); ++i)
+        {
+            bool blocked = false;
+            for (size_t j = 0; j < moves.size() && !blocked; ++j)
+                blocked = j != i && moves[j].src_loc == moves[i].dst_loc;
+            if (!blocked)
+                break;
+        }
+        if (i == moves.size())
+        {
+            string reg = _load_value(moves[0].dst, "t1");
+            if (reg != "t1")
+                _inst("mv", "t1", reg);
+            string loc = moves[0].dst_loc;
+            for (auto &m : moves)
+                if (m.src_loc == loc)
+                    m.src_loc = "t1";
+            continue;
+        }
+        auto &m = moves[i];
+        string reg = m.src_loc == "t1" ? "t1" : _load_addr(m.src, _dest_reg(m.dst, "t0"));
+        _save_value(m.dst, reg);
+        moves.erase(moves.begin() + i);
+    }
+}
+
+// 全局数组初值的游程: 连续的 0 合并为一条 .zero, 连续相同的非 0 值合并为一条 .fill;
+struct DataRun
+{
+    string &out;
+    long long zero_bytes = 0;
+    int32_t word = 0;
+    int word_count = 0;
+
+    DataRun(string &_out) : out(_out) {}
+    void flush()
+    {
+        if (zero_bytes)
+            fmtInst(out, ".zero", zero_bytes);
+        else if (word_count == 1)
+            fmtInst(out, ".word", word);
+        else if (word_count > 1)
+            fmtInst(out, ".fill", word_count, 4, word);
+        zero_bytes = 0;
+        word_count = 0;
+    }
+    void zero(long long bytes)
     {
-        riscv_ret_str += "\t.word ";
-        Visit(init->kind.data.integer);
-        riscv_ret_str += "\n";
+        if (word_count)
+            flush();
+        zero_bytes += bytes;
     }
+    void push(int32_t value)
+    {
+        if (!value)
+        {
+            zero(4);
+            return;
+        }
+        if (zero_bytes || (word_count && word != value))
+            flush();
+        word = value;
+        word_count++;
+    }
+};
+
+void globalArrayInit(const koopa_raw_value_t &init, DataRun &run)
+{
+    if (init->kind.tag == KOOPA_RVT_INTEGER)
+        run.push(init->kind.data.integer.value);
+    else if (init->kind.tag == KOOPA_RVT_ZERO_INIT)
+        run.zero(_cal_size(init->ty));
     else
     {
         auto elems = init->kind.data.aggregate.elems;
         for (size_t i = 0; i < elems.len; ++i)
         {
             auto ptr = elems.buffer[i];
-            globalArrayInit(reinterpret_cast<koopa_raw_value_t>(ptr));
+            globalArrayInit(reinterpret_cast<koopa_raw_value_t>(ptr), run);
         }
     }
 }
 
 // 访问 raw program
-void Visit(const koopa_raw_program_t &program)
+void Visit(const koopa_raw_program_t &program, OutputWriter &out, int opt_level, ThreadPool *pool,
+           const function<void(size_t)> &prepare)
 {
-    // 执行一些其他的必要操作
-
     // 访问所有全局变量
-    Visit(program.values);
-    // 访问所有函数
-    Visit(program.funcs);
+    for (size_t i = 0; i < program.values.len; ++i)
+    {
+        CodeGen gen(opt_level);
+        gen.genGlobal(reinterpret_cast<koopa_raw_value_t>(program.values.buffer[i]));
+        out.write(gen.result());
+    }
+
+    // 访问所有函数, 每个函数使用自己的 CodeGen, 生成完毕就写出
+    assert(program.funcs.kind == KOOPA_RSIK_FUNCTION);
+    size_t n = program.funcs.len;
+    auto gen_func = [&](size_t i, string &result)
+    {
+        auto func = reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i]);
+        if (prepare)
+            prepare(i);
+        CodeGen gen(opt_level);
+        gen.genFunc(func);
+        result.swap(gen.result());
+    };
+    auto is_decl = [&](size_t i)
+    {
+        return reinterpret_cast<koopa_raw_function_t>(program.funcs.buffer[i])->bbs.len == 0;
+    };
+    if (!pool)
+    {
+        string result;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (is_decl(i))
+                continue;
+            gen_func(i, result);
+            out.write(result);
+        }
+        return;
+    }
+
+    // 函数之间没有共享的代码生成状态, 每个函数是线程池中的一个任务;
+    // 完成的函数先放在 funcs_asm 中, 它前面的函数都写出后立即按顺序写出, 与串行生成的汇编完全相同;
+    // 内存中只保留等待前面的函数完成的汇编, 通常只有线程数个函数, 而不是整个程序;
+    vector<string> funcs_asm(n);
+    vector<bool> done(n);
+    size_t next = 0; // 下一个要写出的函数;
+    mutex m;
+    for (size_t i = 0; i < n; ++i)
+        done[i] = is_decl(i);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (done[i])
+            continue;
+        pool->submit([&, i]
+                     {
+                         string result;
+                         gen_func(i, result);
+                         lock_guard<mutex> lock(m);
+                         funcs_asm[i].swap(result);
+                         done[i] = true;
+                         for (; next < n && done[next]; ++next)
+                         {
+                             out.write(funcs_asm[next]);
+                             string().swap(funcs_asm[next]);
+                         } });
+    }
+    pool->wait();
+    for (; next < n; ++next)
+    {
+        assert(done[next]);
+        out.write(funcs_asm[next]);
+    }
 }
 
 // 访问 raw slice
-void Visit(const koopa_raw_slice_t &slice)
+void CodeGen::Visit(const koopa_raw_slice_t &slice)
 {
     for (size_t i = 0; i < slice.len; ++i)
     {
@@ -108,10 +458,6 @@ void Visit(const koopa_raw_slice_t &slice)
         // 根据 slice 的 kind 决定将 ptr 视作何种元素
         switch (slice.kind)
         {
-        case KOOPA_RSIK_FUNCTION:
-            // 访问函数
-            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
-            break;
         case KOOPA_RSIK_BASIC_BLOCK:
             // 访问基本块
             Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
@@ -126,22 +472,42 @@ void Visit(const koopa_raw_slice_t &slice)
         }
     }
 }
-// 访问函数
-void Visit(const koopa_raw_function_t &func)
+// 生成一个函数的汇编, 追加到 riscv_ret_str;
+void CodeGen::genFunc(const koopa_raw_function_t &func)
 {
-    if (func->bbs.len == 0)
-        return;
     // 执行一些其他的必要操作
-    riscv_ret_str += "\t.text\n";
-    riscv_ret_str += "\t.globl " + string(func->name + 1) + "\n";
-    riscv_ret_str += string(func->name + 1) + ":\n";
+    _inst(".text");
+    _inst(".globl", Label(func->name + 1));
+    _label(func->name + 1);
     // ...
 
-    S = 0, R = 0, A = 0;
-    S_ = 0;
+    cur_func = func;
+
+    findFoldedAddrs(func, folded_addrs);
+    findFusedCompares(func, fused_cmps);
+    if (opt_level >= 1)
+        reg_alloc.run(func, folded_addrs, fused_cmps);
+
+    // 没有分到寄存器的函数参数和基本块参数也需要栈上的位置;
+    auto allocSlot = [&](const koopa_raw_value_t &value)
+    {
+        if (!reg_alloc.inReg(value))
+        {
+            var_table.insert(value, S);
+            S += _cal_size(value->ty);
+        }
+    };
+    if (opt_level >= 1)
+    {
+        for (size_t i = 0; i < func->params.len; ++i)
+            allocSlot(reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]));
+    }
+
     for (size_t i = 0; i < func->bbs.len; ++i)
     {
         auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for (size_t j = 0; j < bb->params.len; ++j)
+            allocSlot(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j]));
         for (size_t j = 0; j < bb->insts.len; ++j)
         {
             auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
@@ -156,7 +522,7 @@ void Visit(const koopa_raw_function_t &func)
                 A = max(A, max(0, ((int)inst->kind.data.call.args.len - 8) * 4));
             default:
                 int sz = _cal_size(inst->ty);
-                if (sz)
+                if (sz && !reg_alloc.inReg(inst) && !folded_addrs.count(inst) && !fused_cmps.count(inst))
                 {
                     var_table.insert(inst, S);
                     S += sz;
@@ -166,6 +532,12 @@ void Visit(const koopa_raw_function_t &func)
         }
     }
 
+    for (auto reg : reg_alloc.usedCalleeSaved())
+    {
+        callee_saved.emplace_back(RegAlloc::regName(reg), S + A);
+        S += 4;
+    }
+
     S_ = S + R + A;
 
     if (S_ % 16)
@@ -174,38 +546,71 @@ void Visit(const koopa_raw_function_t &func)
     // 生成 prologue;
     if (R)
     {
-        riscv_ret_str += "\tsw ra, " + to_string(-4) + "(sp)\n";
+        _inst("sw", "ra", Mem(-4, "sp"));
     }
     if (S_)
     {
         if (-S_ >= -2048 && -S_ <= 2047)
         {
-            riscv_ret_str += "\taddi sp, sp, " + to_string(-S_) + "\n";
+            _inst("addi", "sp", "sp", -S_);
         }
         else
         {
-            riscv_ret_str += "\tli t0, " + to_string(-S_) + "\n";
+            _inst("li", "t0", -S_);
 
-            riscv_ret_str += "\tadd sp, sp, t0\n";
+            _inst("add", "sp", "sp", "t0");
         }
     }
 
-    // 访问所有基本块
-    Visit(func->bbs);
+    for (auto &saved : callee_saved)
+        _store_stack(saved.first, saved.second);
+
+    if (opt_level >= 1)
+    {
+        for (size_t i = 0; i < func->params.len; ++i)
+        {
+            auto param = reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]);
+            if (i < 8)
+                _save_value(param, "a" + to_string(i));
+            else
+            {
+                string reg = _dest_reg(param, "t0");
+                _load_stack(reg, (i - 8) * 4 + S_);
+                _save_value(param, reg);
+            }
+        }
+    }
+
+    // 访问所有基本块, 按排布好的顺序, 记录下一个基本块
+    for (size_t i = 0; i < func->bbs.len; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        next_bb = i + 1 < func->bbs.len ? reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i + 1]) : nullptr;
+        emitted_bbs.insert(bb);
+        Visit(bb);
+    }
+    riscv_ret_str += edge_stubs;
+    edge_stubs.clear();
+}
+
+void CodeGen::genGlobal(const koopa_raw_value_t &value)
+{
+    assert(value->kind.tag == KOOPA_RVT_GLOBAL_ALLOC);
+    Visit(value->kind.data.global_alloc, value);
 }
 
 // 访问基本块
-void Visit(const koopa_raw_basic_block_t &bb)
+void CodeGen::Visit(const koopa_raw_basic_block_t &bb)
 {
     // 执行一些其他的必要操作
     if (strcmp(bb->name + 1, "entry"))
-        riscv_ret_str += string(bb->name + 1) + ":\n";
+        _label(bb->name + 1);
     // 访问所有指令
     Visit(bb->insts);
 }
 
 // 访问指令
-void Visit(const koopa_raw_value_t &value)
+void CodeGen::Visit(const koopa_raw_value_t &value)
 {
     // 根据指令类型判断后续需要如何访问
     const auto &kind = value->kind;
@@ -267,75 +672,61 @@ void Visit(const koopa_raw_value_t &value)
 // 访问对应类型指令的函数定义略
 // 视需求自行实现
 // ...
-void Visit(const koopa_raw_return_t &ret)
+void CodeGen::Visit(const koopa_raw_return_t &ret)
 {
     if (ret.value)
     {
-        koopa_raw_value_t ret_value = ret.value;
-        if (ret_value->kind.tag == KOOPA_RVT_INTEGER)
-        {
-            riscv_ret_str += "\tli a0, ";
-            Visit(ret_value->kind.data.integer);
-            riscv_ret_str += "\n";
-        }
-        else if (ret.value->kind.tag == KOOPA_RVT_BINARY || ret.value->kind.tag == KOOPA_RVT_LOAD || ret.value->kind.tag == KOOPA_RVT_CALL)
-        {
-            if (var_table.get(ret_value) <= 2047 && var_table.get(ret_value) >= -2048)
-                riscv_ret_str += "\tlw a0, " + to_string(var_table.get(ret_value)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(ret_value)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw a0, (t6)\n";
-            }
-        }
-        else
-            assert(0);
+        string reg = _load_value(ret.value, "a0");
+        if (reg != "a0")
+            _inst("mv", "a0", reg);
     }
 
+    // 恢复 s 寄存器;
+    for (auto &saved : callee_saved)
+        _load_stack(saved.first, saved.second);
+
     if (S_)
     {
         if (S_ >= -2048 && S_ <= 2047)
         {
-            riscv_ret_str += "\taddi sp, sp, " + to_string(S_) + "\n";
+            _inst("addi", "sp", "sp", S_);
         }
         else
         {
-            riscv_ret_str += "\tli t0, " + to_string(S_) + "\n";
+            _inst("li", "t0", S_);
 
-            riscv_ret_str += "\tadd sp, sp, t0\n";
+            _inst("add", "sp", "sp", "t0");
         }
     }
     if (R)
     {
-        riscv_ret_str += "\tlw ra, " + to_string(-4) + "(sp)\n";
+        _inst("lw", "ra", Mem(-4, "sp"));
     }
-    riscv_ret_str += "\tret\n\n";
+    _inst("ret");
+    riscv_ret_str += '\n';
 }
 
-void Visit(const koopa_raw_integer_t &integer)
+void CodeGen::Visit(const koopa_raw_integer_t &integer)
 {
-    riscv_ret_str += to_string(integer.value);
+    fmtOperand(riscv_ret_str, Imm(integer.value));
     cerr << "--! visit int" << integer.value << endl;
 }
 
-void Visit(const koopa_raw_global_alloc_t &global_alloc, const koopa_raw_value_t &value)
+void CodeGen::Visit(const koopa_raw_global_alloc_t &global_alloc, const koopa_raw_value_t &value)
 {
-    riscv_ret_str += "\t.data\n";
-    riscv_ret_str += "\t.globl " + string(value->name + 1) + "\n";
-    riscv_ret_str += string(value->name + 1) + ":\n";
+    _inst(".data");
+    _inst(".globl", Label(value->name + 1));
+    _label(value->name + 1);
 
     if (value->ty->data.pointer.base->tag == KOOPA_RTT_INT32)
     {
         switch (global_alloc.init->kind.tag)
         {
         case KOOPA_RVT_ZERO_INIT:
-            riscv_ret_str += "\t.zero 4\n";
+            _inst(".zero", 4);
             break;
         case KOOPA_RVT_INTEGER:
-            riscv_ret_str += "\t.word ";
-            Visit(global_alloc.init->kind.data.integer);
-            riscv_ret_str += "\n";
+            _inst(".word", global_alloc.init->kind.data.integer.value);
             break;
         default:
             assert(0);
@@ -347,541 +738,515 @@ void Visit(const koopa_raw_global_alloc_t &global_alloc, const koopa_raw_value_t
         switch (global_alloc.init->kind.tag)
         {
         case KOOPA_RVT_ZERO_INIT:
-            riscv_ret_str += "\t.zero " + to_string(_cal_size(value->ty->data.pointer.base)) + "\n";
+            _inst(".zero", _cal_size(value->ty->data.pointer.base));
             break;
         case KOOPA_RVT_AGGREGATE:
-            globalArrayInit(global_alloc.init);
+        {
+            DataRun run(riscv_ret_str);
+            globalArrayInit(global_alloc.init, run);
+            run.flush();
             break;
+        }
         default:
             assert(0);
             break;
         }
     }
-    riscv_ret_str += "\n";
+    riscv_ret_str += '\n';
 }
 
-void Visit(const koopa_raw_load_t &load, const koopa_raw_value_t &value)
+void CodeGen::Visit(const koopa_raw_load_t &load, const koopa_raw_value_t &value)
 {
     cerr << "--!load" << endl;
-    switch (load.src->kind.tag)
+    string dest = _dest_reg(value, "t0");
+    auto addr = _addr(load.src, "t0");
+    _inst("lw", dest, Mem(addr.second, addr.first));
+    _save_value(value, dest);
+}
+
+void CodeGen::Visit(const koopa_raw_store_t &store)
+{
+    cerr << "--!store" << endl;
+    string val = _load_value(store.value, "t0");
+    auto addr = _addr(store.dest, "t1");
+    _inst("sw", val, Mem(addr.second, addr.first));
+}
+
+// 右操作数是常量时尝试使用 RV32I 的立即数指令, 常量超出 12 位时返回 false;
+bool CodeGen::_binary_imm(koopa_raw_binary_op_t op, const string &dest, const string &lhs, int imm)
+{
+    switch (op)
     {
-    case KOOPA_RVT_GLOBAL_ALLOC:
-        riscv_ret_str += "\tla t0, " + string(load.src->name + 1) + "\n";
-        riscv_ret_str += "\tlw t0, (t0)\n";
-        break;
-    case KOOPA_RVT_ALLOC:
-        if (var_table.get(load.src) <= 2047 && var_table.get(load.src) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(load.src)) + "(sp)\n";
-        else
+    case KOOPA_RBO_ADD:
+        if (!_is_imm12(imm))
+            return false;
+        _inst("addi", dest, lhs, imm);
+        return true;
+    case KOOPA_RBO_SUB:
+        if (!_is_imm12(-(long long)imm))
+            return false;
+        _inst("addi", dest, lhs, -imm);
+        return true;
+    case KOOPA_RBO_AND:
+    case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+        if (!_is_imm12(imm))
+            return false;
+        _inst(op2riscv.at(op) + "i", dest, lhs, imm);
+        return true;
+    case KOOPA_RBO_SHL:
+    case KOOPA_RBO_SHR:
+    case KOOPA_RBO_SAR:
+        _inst(op2riscv.at(op) + "i", dest, lhs, imm & 31);
+        return true;
+    case KOOPA_RBO_LT: // x < c;
+        if (!_is_imm12(imm))
+            return false;
+        _inst("slti", dest, lhs, imm);
+        return true;
+    case KOOPA_RBO_LE: // x <= c 即 x < c+1;
+        if (!_is_imm12(imm + 1LL))
+            return false;
+        _inst("slti", dest, lhs, imm + 1);
+        return true;
+    case KOOPA_RBO_GT: // x > c 即 !(x < c+1);
+        if (!_is_imm12(imm + 1LL))
+            return false;
+        _inst("slti", dest, lhs, imm + 1);
+        _inst("xori", dest, dest, 1);
+        return true;
+    case KOOPA_RBO_GE: // x >= c 即 !(x < c);
+        if (!_is_imm12(imm))
+            return false;
+        _inst("slti", dest, lhs, imm);
+        _inst("xori", dest, dest, 1);
+        return true;
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_NOT_EQ:
+    {
+        const char *set = op == KOOPA_RBO_EQ ? "seqz" : "snez";
+        if (imm == 0)
         {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(load.src)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
+            _inst(set, dest, lhs);
+            return true;
         }
-        break;
+        if (!_is_imm12(imm))
+            return false;
+        _inst("xori", dest, lhs, imm);
+        _inst(set, dest, dest);
+        return true;
+    }
     default:
-        if (var_table.get(load.src) <= 2047 && var_table.get(load.src) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(load.src)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(load.src)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
-        }
-        riscv_ret_str += "\tlw t0, (t0)\n";
-        break;
+        return false;
     }
-    if (var_table.get(value) <= 2047 && var_table.get(value) >= -2048)
-        riscv_ret_str += "\tsw t0, " + to_string(var_table.get(value)) + "(sp)\n";
+}
+
+// 有符号除法的魔数, 见 Hacker's Delight 10-1, 要求 |d| >= 2;
+void _signed_magic(int d, int &magic, int &shift)
+{
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d < 0 ? -(uint32_t)d : d;
+    uint32_t t = two31 + ((uint32_t)d >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    int p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do
+    {
+        p++;
+        q1 *= 2, r1 *= 2;
+        if (r1 >= anc)
+            q1++, r1 -= anc;
+        q2 *= 2, r2 *= 2;
+        if (r2 >= ad)
+            q2++, r2 -= ad;
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    magic = q2 + 1;
+    if (d < 0)
+        magic = -magic;
+    shift = p - 32;
+}
+
+// x * c, c > 0 且最多两条移位加一条加减时返回 true;
+bool CodeGen::_mul_shift(const string &dest, const string &x, uint32_t c)
+{
+    int k = _log2(c);
+    if (k >= 0)
+    {
+        _inst("slli", dest, x, k);
+        return true;
+    }
+    // c = 2^a + 2^b 或 2^a - 2^b;
+    uint32_t low = c & -c;
+    int a = _log2(c - low), b = _log2(low);
+    const char *op = "add";
+    if (a < 0)
+    {
+        a = _log2(c + low);
+        op = "sub";
+    }
+    if (a < 0 || a > 31)
+        return false;
+    _inst("slli", "t1", x, a);
+    string rhs = x;
+    if (b)
+    {
+        _inst("slli", "t2", x, b);
+        rhs = "t2";
+    }
+    _inst(op, dest, "t1", rhs);
+    return true;
+}
+
+// 除数为 ±2^k 时的商向 0 取整需要的偏置: x < 0 时为 2^k - 1, 结果在 t1 中;
+void CodeGen::_div_bias(const string &x, int k)
+{
+    if (k == 1)
+        _inst("srli", "t1", x, 31);
     else
     {
-        riscv_ret_str += "\tli t6, " + to_string(var_table.get(value)) + "\n";
-        riscv_ret_str += "\tadd t6, t6, sp\n";
-        riscv_ret_str += "\tsw t0, (t6)\n";
+        _inst("srai", "t1", x, 31);
+        _inst("srli", "t1", "t1", 32 - k);
     }
+    _inst("add", "t1", x, "t1");
 }
 
-void Visit(const koopa_raw_store_t &store)
+// 乘除模常量的强度削弱, 保持 C 向 0 取整的语义, 无法处理时返回 false 使用 mul/div/rem;
+// 只使用 t1, t2 作为临时寄存器, dest 可能和 x 相同, 所以只在最后一条指令写 dest;
+bool CodeGen::_mul_div_const(koopa_raw_binary_op_t op, const string &dest, const string &x, int c)
 {
-    cerr << "--!store" << endl;
-    size_t param_idx = 0;
-    switch (store.value->kind.tag)
+    if (c == INT_MIN || (c == 0 && op != KOOPA_RBO_MUL))
+        return false;
+    uint32_t ac = c < 0 ? -(uint32_t)c : c;
+    int k = _log2(ac);
+    switch (op)
     {
-    case KOOPA_RVT_INTEGER:
-        riscv_ret_str += "\tli t0, ";
-        Visit(store.value->kind.data.integer);
-        riscv_ret_str += "\n";
-        switch (store.dest->kind.tag)
-        {
-        case KOOPA_RVT_GLOBAL_ALLOC:
-            riscv_ret_str += "\tla t1, " + string(store.dest->name + 1) + "\n";
-            riscv_ret_str += "\tsw t0, (t1)\n";
-            break;
-        case KOOPA_RVT_ALLOC:
-            if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                riscv_ret_str += "\tsw t0, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tsw t0, (t6)\n";
-            }
-            break;
-        case KOOPA_RVT_GET_ELEM_PTR:
-        case KOOPA_RVT_GET_PTR:
-            if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                riscv_ret_str += "\tlw t1, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw t1, (t6)\n";
-            }
-            riscv_ret_str += "\tsw t0, (t1)\n";
-            break;
-        default:
-            assert(0);
+    case KOOPA_RBO_MUL:
+        if (c == 0)
+        {
+            _inst("li", dest, 0);
+            return true;
         }
-        break;
-    case KOOPA_RVT_FUNC_ARG_REF:
-        param_idx = store.value->kind.data.func_arg_ref.index;
-        if (param_idx < 8)
+        if (c > 0)
+            return _mul_shift(dest, x, ac);
+        if (!_mul_shift("t1", x, ac))
+            return false;
+        _inst("sub", dest, "x0", "t1");
+        return true;
+    case KOOPA_RBO_DIV:
+        if (ac == 1)
         {
-            switch (store.dest->kind.tag)
-            {
-            case KOOPA_RVT_GLOBAL_ALLOC:
-                riscv_ret_str += "\tla t0, " + string(store.dest->name + 1) + "\n";
-                riscv_ret_str += "\tsw a" + to_string(param_idx) + ", (t0)\n";
-                break;
-            case KOOPA_RVT_ALLOC:
-                if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                    riscv_ret_str += "\tsw a" + to_string(param_idx) + ", " + to_string(var_table.get(store.dest)) + "(sp)\n";
-                else
-                {
-                    riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                    riscv_ret_str += "\tadd t6, t6, sp\n";
-                    riscv_ret_str += "\tsw a" + to_string(param_idx) + ", (t6)\n";
-                }
-                break;
-            case KOOPA_RVT_GET_ELEM_PTR:
-            case KOOPA_RVT_GET_PTR:
-                if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                    riscv_ret_str += "\tlw t0, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-                else
-                {
-                    riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                    riscv_ret_str += "\tadd t6, t6, sp\n";
-                    riscv_ret_str += "\tlw t0, (t6)\n";
-                }
-                riscv_ret_str += "\tsw a" + to_string(param_idx) + ", (t0)\n";
-                break;
-            default:
-                assert(0);
-            }
+            if (c == 1)
+                _inst("mv", dest, x);
+            else
+                _inst("sub", dest, "x0", x);
+            return true;
         }
-        else
+        if (k > 0)
         {
-            if ((param_idx - 8) * 4 + S_ <= 2047 && (param_idx - 8) * 4 + S_ >= -2048)
-                riscv_ret_str += "\tlw t0, " + to_string((param_idx - 8) * 4 + S_) + "(sp)\n";
+            _div_bias(x, k);
+            if (c > 0)
+                _inst("srai", dest, "t1", k);
             else
             {
-                riscv_ret_str += "\tli t6, " + to_string((param_idx - 8) * 4 + S_) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw t0, (t6)\n";
-            }
-            switch (store.dest->kind.tag)
-            {
-            case KOOPA_RVT_GLOBAL_ALLOC:
-                riscv_ret_str += "\tla t1, " + string(store.dest->name + 1) + "\n";
-                riscv_ret_str += "\tsw t0, (t1)\n";
-                break;
-            case KOOPA_RVT_ALLOC:
-                if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                    riscv_ret_str += "\tsw t0, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-                else
-                {
-                    riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                    riscv_ret_str += "\tadd t6, t6, sp\n";
-                    riscv_ret_str += "\tsw t0, (t6)\n";
-                }
-                break;
-            case KOOPA_RVT_GET_ELEM_PTR:
-            case KOOPA_RVT_GET_PTR:
-                if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                    riscv_ret_str += "\tlw t1, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-                else
-                {
-                    riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                    riscv_ret_str += "\tadd t6, t6, sp\n";
-                    riscv_ret_str += "\tlw t1, (t6)\n";
-                }
-                riscv_ret_str += "\tsw t0, (t1)\n";
-                break;
-            default:
-                assert(0);
+                _inst("srai", "t1", "t1", k);
+                _inst("sub", dest, "x0", "t1");
             }
+            return true;
         }
         break;
-    default:
-        if (var_table.get(store.value) <= 2047 && var_table.get(store.value) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(store.value)) + "(sp)\n";
-        else
+    case KOOPA_RBO_MOD:
+        if (ac == 1)
         {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.value)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
+            _inst("li", dest, 0);
+            return true;
         }
-        switch (store.dest->kind.tag)
+        if (k > 0)
         {
-        case KOOPA_RVT_GLOBAL_ALLOC:
-            riscv_ret_str += "\tla t1, " + string(store.dest->name + 1) + "\n";
-            riscv_ret_str += "\tsw t0, (t1)\n";
-            break;
-        case KOOPA_RVT_ALLOC:
-            if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                riscv_ret_str += "\tsw t0, " + to_string(var_table.get(store.dest)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tsw t0, (t6)\n";
-            }
-            break;
-        case KOOPA_RVT_GET_ELEM_PTR:
-        case KOOPA_RVT_GET_PTR:
-            if (var_table.get(store.dest) <= 2047 && var_table.get(store.dest) >= -2048)
-                riscv_ret_str += "\tlw t1, " + to_string(var_table.get(store.dest)) + "(sp)\n";
+            // x - ((x + bias) & -2^k);
+            _div_bias(x, k);
+            if (k <= 11)
+                _inst("andi", "t1", "t1", -(1 << k));
             else
             {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(store.dest)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw t1, (t6)\n";
+                _inst("srai", "t1", "t1", k);
+                _inst("slli", "t1", "t1", k);
             }
-            riscv_ret_str += "\tsw t0, (t1)\n";
-            break;
-        default:
-            assert(0);
+            _inst("sub", dest, x, "t1");
+            return true;
         }
         break;
+    default:
+        return false;
     }
-}
 
-void Visit(const koopa_raw_binary_t &binary, const koopa_raw_value_t &value)
-{
-    if (binary.lhs->kind.tag == KOOPA_RVT_INTEGER)
+    // 商 = mulh(x, magic) 修正后算术右移, 再加上符号位使负数的商向 0 取整;
+    int magic, shift;
+    _signed_magic(c, magic, shift);
+    _inst("li", "t1", magic);
+    _inst("mulh", "t1", x, "t1");
+    if (c > 0 && magic < 0)
+        _inst("add", "t1", "t1", x);
+    else if (c < 0 && magic > 0)
+        _inst("sub", "t1", "t1", x);
+    if (shift)
+        _inst("srai", "t1", "t1", shift);
+    _inst("srli", "t2", "t1", 31);
+    if (op == KOOPA_RBO_DIV)
     {
-        riscv_ret_str += "\tli t0, ";
-        Visit(binary.lhs->kind.data.integer);
-        riscv_ret_str += "\n";
-    }
-    else
-    {
-        if (var_table.get(binary.lhs) <= 2047 && var_table.get(binary.lhs) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(binary.lhs)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(binary.lhs)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
-        }
+        _inst("add", dest, "t1", "t2");
+        return true;
     }
+    // 余数 = x - 商 * c;
+    _inst("add", "t1", "t1", "t2");
+    _inst("li", "t2", ac);
+    _inst("mul", "t1", "t1", "t2");
+    _inst(c > 0 ? "sub" : "add", dest, x, "t1");
+    return true;
+}
+
+void CodeGen::Visit(const koopa_raw_binary_t &binary, const koopa_raw_value_t &value)
+{
+    // 合并进 branch 的比较在 branch 处生成;
+    if (fused_cmps.count(value))
+        return;
 
-    if (binary.rhs->kind.tag == KOOPA_RVT_INTEGER)
+    // 常量在左边时交换操作数, 比较运算同时翻转, 以便使用立即数形式;
+    koopa_raw_binary_op_t op = binary.op;
+    koopa_raw_value_t lhs_v = binary.lhs, rhs_v = binary.rhs;
+    koopa_raw_binary_op_t swapped;
+    if (lhs_v->kind.tag == KOOPA_RVT_INTEGER && rhs_v->kind.tag != KOOPA_RVT_INTEGER && swapBinaryOp(op, swapped))
     {
-        riscv_ret_str += "\tli t1, ";
-        Visit(binary.rhs->kind.data.integer);
-        riscv_ret_str += "\n";
+        swap(lhs_v, rhs_v);
+        op = swapped;
     }
-    else
+
+    string lhs = _load_value(lhs_v, "t0");
+    if (rhs_v->kind.tag == KOOPA_RVT_INTEGER)
     {
-        if (var_table.get(binary.rhs) <= 2047 && var_table.get(binary.rhs) >= -2048)
-            riscv_ret_str += "\tlw t1, " + to_string(var_table.get(binary.rhs)) + "(sp)\n";
-        else
+        string dest = _dest_reg(value, "t0");
+        if (_mul_div_const(op, dest, lhs, rhs_v->kind.data.integer.value) ||
+            _binary_imm(op, dest, lhs, rhs_v->kind.data.integer.value))
         {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(binary.rhs)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t1, (t6)\n";
+            _save_value(value, dest);
+            return;
         }
     }
+    string rhs = _load_value(rhs_v, "t1");
+    string dest = _dest_reg(value, "t0");
 
-    switch (binary.op)
+    switch (op)
     {
     case KOOPA_RBO_LE:
-        riscv_ret_str += "\tsgt t0, t0, t1\n";
-        riscv_ret_str += "\tseqz t0, t0\n";
+        _inst("sgt", dest, lhs, rhs);
+        _inst("seqz", dest, dest);
         break;
     case KOOPA_RBO_GE:
-        riscv_ret_str += "\tslt t0, t0, t1\n";
-        riscv_ret_str += "\tseqz t0, t0\n";
+        _inst("slt", dest, lhs, rhs);
+        _inst("seqz", dest, dest);
         break;
     case KOOPA_RBO_NOT_EQ:
-        riscv_ret_str += "\txor t0, t0, t1\n";
-        riscv_ret_str += "\tsnez t0, t0\n";
+        _inst("xor", dest, lhs, rhs);
+        _inst("snez", dest, dest);
         break;
     case KOOPA_RBO_EQ:
-        riscv_ret_str += "\txor t0, t0, t1\n";
-        riscv_ret_str += "\tseqz t0, t0\n";
+        _inst("xor", dest, lhs, rhs);
+        _inst("seqz", dest, dest);
         break;
     default:
-        riscv_ret_str += "\t" + op2riscv[binary.op] + " t0, t0, t1\n";
+        _inst(op2riscv.at(op), dest, lhs, rhs);
         break;
     }
-    if (var_table.get(value) <= 2047 && var_table.get(value) >= -2048)
-        riscv_ret_str += "\tsw t0, " + to_string(var_table.get(value)) + "(sp)\n";
-    else
-    {
-        riscv_ret_str += "\tli t6, " + to_string(var_table.get(value)) + "\n";
-        riscv_ret_str += "\tadd t6, t6, sp\n";
-        riscv_ret_str += "\tsw t0, (t6)\n";
-    }
+    _save_value(value, dest);
 }
 
-void Visit(const koopa_raw_branch_t &branch)
+// cond 为真 (when 为 false 时为假) 时跳到 target, 合并的比较生成一条比较跳转指令;
+void CodeGen::_branch_if(const koopa_raw_value_t &cond, bool when, const Label &target)
 {
-    if (branch.cond->kind.tag == KOOPA_RVT_INTEGER)
+    if (!fused_cmps.count(cond))
     {
-        riscv_ret_str += "\tli t0, ";
-        Visit(branch.cond->kind.data.integer);
-        riscv_ret_str += "\n";
+        _inst(when ? "bnez" : "beqz", _load_value(cond, "t0"), target);
+        return;
     }
-    else
+
+    const auto &binary = cond->kind.data.binary;
+    string lhs = _load_value(binary.lhs, "t0");
+    string rhs = _load_value(binary.rhs, "t1");
+    const char *op;
+    switch (binary.op)
     {
-        if (var_table.get(branch.cond) <= 2047 && var_table.get(branch.cond) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(branch.cond)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(branch.cond)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
-        }
+    case KOOPA_RBO_EQ:
+        op = when ? "beq" : "bne";
+        break;
+    case KOOPA_RBO_NOT_EQ:
+        op = when ? "bne" : "beq";
+        break;
+    case KOOPA_RBO_LT:
+        op = when ? "blt" : "bge";
+        break;
+    case KOOPA_RBO_GE:
+        op = when ? "bge" : "blt";
+        break;
+    case KOOPA_RBO_GT:
+        op = when ? "bgt" : "ble";
+        break;
+    case KOOPA_RBO_LE:
+        op = when ? "ble" : "bgt";
+        break;
+    default:
+        assert(false);
+        return;
     }
-
-    riscv_ret_str += "\tbnez t0, " + string(branch.true_bb->name + 1) + "\n";
-    riscv_ret_str += "\tj " + string(branch.false_bb->name + 1) + "\n";
+    _inst(op, lhs, rhs, target);
 }
 
-void Visit(const koopa_raw_jump_t &jump)
+// 跳到 target, target 紧跟在后面时顺序执行;
+void CodeGen::_jump(const koopa_raw_basic_block_t &target)
 {
-    riscv_ret_str += "\tj " + string(jump.target->name + 1) + "\n";
+    if (target != next_bb)
+        _inst("j", Label(target->name + 1));
 }
 
-void Visit(const koopa_raw_call_t &call, const koopa_raw_value_t &value)
+// 向 target 的参数传值时是否会覆盖 reads 中某个值的位置, 实参已经在参数的位置上时不需要写入;
+bool CodeGen::_args_clobber(const koopa_raw_slice_t &args, const koopa_raw_basic_block_t &target, const vector<koopa_raw_value_t> &reads)
 {
-    for (size_t i = 0; i < call.args.len; ++i)
+    for (size_t i = 0; i < target->params.len; ++i)
     {
-        if (i == 8)
-            break;
-
-        auto val = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
-        if (val->kind.tag == KOOPA_RVT_INTEGER)
+        string loc = _location(reinterpret_cast<koopa_raw_value_t>(target->params.buffer[i]));
+        if (loc.empty() || loc == _location(reinterpret_cast<koopa_raw_value_t>(args.buffer[i])))
+            continue;
+        for (auto v : reads)
         {
-            riscv_ret_str += "\tli a" + to_string(i) + ", ";
-            Visit(val->kind.data.integer);
-            riscv_ret_str += "\n";
-        }
-        else
-        {
-            if (var_table.get(val) <= 2047 && var_table.get(val) >= -2048)
-                riscv_ret_str += "\tlw a" + to_string(i) + ", " + to_string(var_table.get(val)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(val)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw a" + to_string(i) + ", (t6)\n";
-            }
+            if (_location(v) == loc)
+                return true;
         }
     }
+    return false;
+}
 
-    for (size_t i = 8; i < call.args.len; ++i) // 栈上传参, 已经预留好空间;
-    {
-        auto val = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
-        if (val->kind.tag == KOOPA_RVT_INTEGER)
-        {
-            riscv_ret_str += "\tli t0, ";
-            Visit(val->kind.data.integer);
-            riscv_ret_str += "\n";
-
-            if ((i - 8) * 4 <= 2047 && (i - 8) * 4 >= -2048)
-                riscv_ret_str += "\tsw t0, " + to_string((i - 8) * 4) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string((i - 8) * 4) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tsw t0, (t6)\n";
-            }
-        }
-        else
-        {
-            if (var_table.get(val) <= 2047 && var_table.get(val) >= -2048)
-                riscv_ret_str += "\tlw t0, " + to_string(var_table.get(val)) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string(var_table.get(val)) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tlw t0, (t6)\n";
-            }
-
-            if ((i - 8) * 4 <= 2047 && (i - 8) * 4 >= -2048)
-                riscv_ret_str += "\tsw t0, " + to_string((i - 8) * 4) + "(sp)\n";
-            else
-            {
-                riscv_ret_str += "\tli t6, " + to_string((i - 8) * 4) + "\n";
-                riscv_ret_str += "\tadd t6, t6, sp\n";
-                riscv_ret_str += "\tsw t0, (t6)\n";
-            }
-        }
-    }
-
-    riscv_ret_str += "\tcall " + string(call.callee->name + 1) + "\n";
-
-    if (value->ty->tag != KOOPA_RTT_UNIT)
+void CodeGen::Visit(const koopa_raw_branch_t &branch)
+{
+    // 真分支紧跟在后面, 假分支没有参数时反转条件, 真分支的参数在顺序执行的路径上传递;
+    if (!branch.false_args.len && branch.true_bb == next_bb)
     {
-        if (var_table.get(value) <= 2047 && var_table.get(value) >= -2048)
-            riscv_ret_str += "\tsw a0, " + to_string(var_table.get(value)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(value)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tsw a0, (t6)\n";
-        }
+        _branch_if(branch.cond, false, Label(branch.false_bb->name + 1));
+        _move_args(branch.true_args, branch.true_bb);
+        return;
     }
-}
 
-void Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr, const koopa_raw_value_t &value)
-{
-    int addr = 0;
-    switch (get_elem_ptr.src->kind.tag)
+    // 回边 (通常是旋转后循环的回边) 的参数在跳转前传递, 只需要一条条件跳转:
+    // 真分支的参数在本基本块的末尾活跃, 不会和假分支用到的值共用位置, 只需检查条件和假分支的实参;
+    if (branch.true_args.len && emitted_bbs.count(branch.true_bb))
     {
-    case KOOPA_RVT_GLOBAL_ALLOC:
-        riscv_ret_str += "\tla t0, " + string(get_elem_ptr.src->name + 1) + "\n";
-        break;
-    case KOOPA_RVT_ALLOC:
-        addr = var_table.get(get_elem_ptr.src);
-        if (addr <= 2047 && addr >= -2048)
+        vector<koopa_raw_value_t> reads;
+        if (fused_cmps.count(branch.cond))
         {
-            riscv_ret_str += "\taddi t0, sp, " + to_string(addr) + "\n";
+            reads.push_back(branch.cond->kind.data.binary.lhs);
+            reads.push_back(branch.cond->kind.data.binary.rhs);
         }
         else
+            reads.push_back(branch.cond);
+        for (size_t i = 0; i < branch.false_args.len; ++i)
+            reads.push_back(reinterpret_cast<koopa_raw_value_t>(branch.false_args.buffer[i]));
+        if (!_args_clobber(branch.true_args, branch.true_bb, reads))
         {
-            riscv_ret_str += "\tli t0, " + to_string(addr) + "\n";
-            riscv_ret_str += "\tadd t0, sp, t0\n";
+            _move_args(branch.true_args, branch.true_bb);
+            _branch_if(branch.cond, true, Label(branch.true_bb->name + 1));
+            _move_args(branch.false_args, branch.false_bb);
+            _jump(branch.false_bb);
+            return;
         }
-        break;
-    case KOOPA_RVT_GET_ELEM_PTR:
-    case KOOPA_RVT_GET_PTR:
-        cerr << "--!getelemptr here" << endl;
-        if (var_table.get(get_elem_ptr.src) <= 2047 && var_table.get(get_elem_ptr.src) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(get_elem_ptr.src)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(get_elem_ptr.src)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
-        }
-        break;
-    default:
-        assert(0);
-        break;
     }
 
-    if (get_elem_ptr.index->kind.tag == KOOPA_RVT_INTEGER)
+    if (!branch.true_args.len)
     {
-        riscv_ret_str += "\tli t1, ";
-        Visit(get_elem_ptr.index->kind.data.integer);
-        riscv_ret_str += "\n";
+        _branch_if(branch.cond, true, Label(branch.true_bb->name + 1));
+        _move_args(branch.false_args, branch.false_bb);
+        _jump(branch.false_bb);
+        return;
     }
-    else
+
+    // 假分支没有参数也不紧跟在后面时反转条件, 真分支的参数在顺序执行的路径上传递;
+    if (!branch.false_args.len && branch.false_bb != next_bb)
     {
-        if (var_table.get(get_elem_ptr.index) <= 2047 && var_table.get(get_elem_ptr.index) >= -2048)
-            riscv_ret_str += "\tlw t1, " + to_string(var_table.get(get_elem_ptr.index)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(get_elem_ptr.index)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t1, (t6)\n";
-        }
+        _branch_if(branch.cond, false, Label(branch.false_bb->name + 1));
+        _move_args(branch.true_args, branch.true_bb);
+        _jump(branch.true_bb);
+        return;
     }
 
-    riscv_ret_str += "\tli t2, " + to_string(_cal_size(get_elem_ptr.src->ty->data.pointer.base->data.array.base)) + "\n";
-
-    riscv_ret_str += "\tmul t1, t1, t2\n";
-    riscv_ret_str += "\tadd t0, t0, t1\n";
-
-    if (var_table.get(value) <= 2047 && var_table.get(value) >= -2048)
-        riscv_ret_str += "\tsw t0, " + to_string(var_table.get(value)) + "(sp)\n";
-    else
+    // 不紧跟在后面的分支的传参放在函数末尾, 另一个分支顺序执行;
+    bool when = branch.true_bb != next_bb;
+    auto stub_bb = when ? branch.true_bb : branch.false_bb;
+    auto &stub_args = when ? branch.true_args : branch.false_args;
+    string edge = ".Ledge_" + string(cur_func->name + 1) + "_" + to_string(edge_label_no++);
+    _branch_if(branch.cond, when, Label(edge));
+    if (when)
     {
-        riscv_ret_str += "\tli t6, " + to_string(var_table.get(value)) + "\n";
-        riscv_ret_str += "\tadd t6, t6, sp\n";
-        riscv_ret_str += "\tsw t0, (t6)\n";
+        _move_args(branch.false_args, branch.false_bb);
+        _jump(branch.false_bb);
     }
+    else
+        _move_args(branch.true_args, branch.true_bb);
+    riscv_ret_str.swap(edge_stubs);
+    _label(edge);
+    _move_args(stub_args, stub_bb);
+    _inst("j", Label(stub_bb->name + 1));
+    riscv_ret_str.swap(edge_stubs);
 }
 
-void Visit(const koopa_raw_get_ptr_t &get_ptr, const koopa_raw_value_t &value)
+void CodeGen::Visit(const koopa_raw_jump_t &jump)
 {
-    int addr = 0;
-    switch (get_ptr.src->kind.tag)
-    {
-    case KOOPA_RVT_GLOBAL_ALLOC:
-        riscv_ret_str += "\tla t0, " + string(get_ptr.src->name + 1) + "\n";
-        break;
-    case KOOPA_RVT_ALLOC:
-        addr = var_table.get(get_ptr.src);
-        if (addr <= 2047 && addr >= -2048)
-        {
-            riscv_ret_str += "\taddi t0, sp, " + to_string(addr) + "\n";
-        }
-        else
-        {
-            riscv_ret_str += "\tli t0, " + to_string(addr) + "\n";
-            riscv_ret_str += "\tadd t0, sp, t0\n";
-        }
-        break;
-    case KOOPA_RVT_GET_ELEM_PTR:
-    case KOOPA_RVT_GET_PTR:
-    case KOOPA_RVT_LOAD:
+    _move_args(jump.args, jump.target);
+    _jump(jump.target);
+}
 
-        if (var_table.get(get_ptr.src) <= 2047 && var_table.get(get_ptr.src) >= -2048)
-            riscv_ret_str += "\tlw t0, " + to_string(var_table.get(get_ptr.src)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(get_ptr.src)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t0, (t6)\n";
-        }
-        break;
-    default:
-        assert(0);
-        break;
-    }
-    if (get_ptr.index->kind.tag == KOOPA_RVT_INTEGER)
+void CodeGen::Visit(const koopa_raw_call_t &call, const koopa_raw_value_t &value)
+{
+    // a0-a7 不参与寄存器分配, 依次写入不会覆盖其他实参;
+    for (size_t i = 0; i < call.args.len && i < 8; ++i)
     {
-        riscv_ret_str += "\tli t1, ";
-        Visit(get_ptr.index->kind.data.integer);
-        riscv_ret_str += "\n";
+        auto val = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
+        string arg_reg = "a" + to_string(i);
+        string reg = _load_value(val, arg_reg);
+        if (reg != arg_reg)
+            _inst("mv", arg_reg, reg);
     }
-    else
+
+    for (size_t i = 8; i < call.args.len; ++i) // 栈上传参, 已经预留好空间;
     {
-        if (var_table.get(get_ptr.index) <= 2047 && var_table.get(get_ptr.index) >= -2048)
-            riscv_ret_str += "\tlw t1, " + to_string(var_table.get(get_ptr.index)) + "(sp)\n";
-        else
-        {
-            riscv_ret_str += "\tli t6, " + to_string(var_table.get(get_ptr.index)) + "\n";
-            riscv_ret_str += "\tadd t6, t6, sp\n";
-            riscv_ret_str += "\tlw t1, (t6)\n";
-        }
+        auto val = reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
+        string reg = _load_value(val, "t0");
+        _store_stack(reg, (i - 8) * 4);
     }
 
-    riscv_ret_str += "\tli t2, " + to_string(_cal_size(get_ptr.src->ty->data.pointer.base)) + "\n";
-    riscv_ret_str += "\tmul t1, t1, t2\n";
-    riscv_ret_str += "\tadd t0, t0, t1\n";
+    _inst("call", Label(call.callee->name + 1));
 
-    if (var_table.get(value) <= 2047 && var_table.get(value) >= -2048)
-        riscv_ret_str += "\tsw t0, " + to_string(var_table.get(value)) + "(sp)\n";
-    else
-    {
-        riscv_ret_str += "\tli t6, " + to_string(var_table.get(value)) + "\n";
-        riscv_ret_str += "\tadd t6, t6, sp\n";
-        riscv_ret_str += "\tsw t0, (t6)\n";
-    }
+    if (value->ty->tag != KOOPA_RTT_UNIT)
+        _save_value(value, "a0");
+}
+
+// 折叠的地址在使用者处计算;
+void CodeGen::Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr, const koopa_raw_value_t &value)
+{
+    if (folded_addrs.count(value))
+        return;
+    auto addr = _addr(value, "t0", true);
+    string dest = _dest_reg(value, "t0");
+    if (addr.second || dest != addr.first)
+        _inst("addi", dest, addr.first, addr.second);
+    _save_value(value, dest);
+}
+
+void CodeGen::Visit(const koopa_raw_get_ptr_t &get_ptr, const koopa_raw_value_t &value)
+{
+    if (folded_addrs.count(value))
+        return;
+    auto addr = _addr(value, "t0", true);
+    string dest = _dest_reg(value, "t0");
+    if (addr.second || dest != addr.first)
+        _inst("addi", dest, addr.first, addr.second);
+    _save_value(value, dest);
 }
\ No newline at end of file
@@ -1,38 +1,111 @@
 #include "koopa.h"
+#include "asm_fmt.hpp"
+#include "output.hpp"
+#include "reg_alloc.hpp"
+#include "simplify.hpp"
+#include "thread_pool.hpp"
 #include <cassert>
+#include <climits>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <string.h>
 using namespace std;
 
-extern string riscv_ret_str;
-
-void Visit(const koopa_raw_program_t &program);
-void Visit(const koopa_raw_slice_t &slice);
-void Visit(const koopa_raw_function_t &func);
-void Visit(const koopa_raw_basic_block_t &bb);
-void Visit(const koopa_raw_value_t &value);
-
-void Visit(const koopa_raw_return_t &ret);
-void Visit(const koopa_raw_integer_t &integer);
-void Visit(const koopa_raw_binary_t &binary, const koopa_raw_value_t &value);
-void Visit(const koopa_raw_load_t &load, const koopa_raw_value_t &value);
-void Visit(const koopa_raw_store_t &store);
-void Visit(const koopa_raw_branch_t &branch);
-void Visit(const koopa_raw_jump_t &jump);
-void Visit(const koopa_raw_call_t &call, const koopa_raw_value_t &value);
-void Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr, const koopa_raw_value_t &value);
-void Visit(const koopa_raw_get_ptr_t &get_ptr, const koopa_raw_value_t &value);
-
-void Visit(const koopa_raw_global_alloc_t &global_alloc, const koopa_raw_value_t &value);
+// 访问 raw program, 汇编按函数或全局变量写到 out, opt_level 为 1 时启用寄存器分配;
+// prepare 不为空时在生成第 i 个函数之前调用 prepare(i), 用于逐个函数的优化;
+// pool 不为空时每个函数的 prepare 和生成是线程池中的一个任务, 输出与串行生成相同;
+void Visit(const koopa_raw_program_t &program, OutputWriter &out, int opt_level, ThreadPool *pool = nullptr,
+           const function<void(size_t)> &prepare = nullptr);
 
 class VarTable
 {
     unordered_map<koopa_raw_value_t, int> table;
+    const int &A; // 所属 CodeGen 为传参预留的空间;
 
 public:
+    VarTable(const int &_A) : A(_A) {}
     void insert(const koopa_raw_value_t &value, int addr);
     bool exist(const koopa_raw_value_t &value);
     int get(const koopa_raw_value_t &value);
+};
+
+// 一个函数或全局变量的代码生成, 栈帧, 变量位置, 寄存器分配结果和生成的汇编都属于这个对象;
+// 每个函数使用自己的 CodeGen, 不同的函数之间没有共享的状态;
+class CodeGen
+{
+    int opt_level;
+    string riscv_ret_str; // 生成的汇编;
+
+    koopa_raw_function_t cur_func = nullptr;
+    int S = 0, R = 0, A = 0;
+    int S_ = 0;
+    VarTable var_table{A};
+    RegAlloc reg_alloc;
+    // 函数中用到的 s 寄存器和保存它们的栈偏移;
+    vector<pair<string, int>> callee_saved;
+    // 带参数的 branch 在真分支上需要单独的一段代码做参数传递, 标号按函数编号;
+    int edge_label_no = 0;
+    // 折叠进使用者寻址的 getelemptr/getptr, 不占据位置;
+    unordered_set<koopa_raw_value_t> folded_addrs;
+    // 合并进 branch 的比较, 不占据位置;
+    unordered_set<koopa_raw_value_t> fused_cmps;
+    // 紧跟在当前基本块后面的基本块, 跳到它的 jump 可以省略;
+    koopa_raw_basic_block_t next_bb = nullptr;
+    // 已经生成的基本块, 跳到它们的边是回边;
+    unordered_set<koopa_raw_basic_block_t> emitted_bbs;
+    // 带参数的 branch 真分支上传参的代码, 放在函数末尾, 不打断顺序执行的路径;
+    string edge_stubs;
+
+    // 向汇编追加一条指令或一个标号;
+    template <typename... Ops>
+    void _inst(string_view op, const Ops &...ops) { fmtInst(riscv_ret_str, op, ops...); }
+    void _label(string_view name) { fmtLabel(riscv_ret_str, name); }
+
+    void _load_stack(const string &reg, int offset);
+    void _store_stack(const string &reg, int offset);
+    string _load_value(const koopa_raw_value_t &value, const string &tmp);
+    string _load_addr(const koopa_raw_value_t &value, const string &tmp);
+    pair<string, int> _addr(const koopa_raw_value_t &ptr, const string &tmp, bool self = false);
+    string _dest_reg(const koopa_raw_value_t &value, const string &tmp);
+    void _save_value(const koopa_raw_value_t &value, const string &reg);
+    string _location(const koopa_raw_value_t &value);
+    void _move_args(const koopa_raw_slice_t &args, const koopa_raw_basic_block_t &target);
+    bool _binary_imm(koopa_raw_binary_op_t op, const string &dest, const string &lhs, int imm);
+    bool _mul_shift(const string &dest, const string &x, uint32_t c);
+    void _div_bias(const string &x, int k);
+    bool _mul_div_const(koopa_raw_binary_op_t op, const string &dest, const string &x, int c);
+    void _branch_if(const koopa_raw_value_t &cond, bool when, const Label &target);
+    void _jump(const koopa_raw_basic_block_t &target);
+    bool _args_clobber(const koopa_raw_slice_t &args, const koopa_raw_basic_block_t &target, const vector<koopa_raw_value_t> &reads);
+
+    void Visit(const koopa_raw_slice_t &slice);
+    void Visit(const koopa_raw_basic_block_t &bb);
+    void Visit(const koopa_raw_value_t &value);
+
+    void Visit(const koopa_raw_return_t &ret);
+    void Visit(const koopa_raw_integer_t &integer);
+    void Visit(const koopa_raw_binary_t &binary, const koopa_raw_value_t &value);
+    void Visit(const koopa_raw_load_t &load, const koopa_raw_value_t &value);
+    void Visit(const koopa_raw_store_t &store);
+    void Visit(const koopa_raw_branch_t &branch);
+    void Visit(const koopa_raw_jump_t &jump);
+    void Visit(const koopa_raw_call_t &call, const koopa_raw_value_t &value);
+    void Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr, const koopa_raw_value_t &value);
+    void Visit(const koopa_raw_get_ptr_t &get_ptr, const koopa_raw_value_t &value);
+
+    void Visit(const koopa_raw_global_alloc_t &global_alloc, const koopa_raw_value_t &value);
+
+public:
+    CodeGen(int _opt_level) : opt_level(_opt_level) {}
+
+    // 生成一个函数的汇编;
+    void genFunc(const koopa_raw_function_t &func);
+    // 生成一个全局变量的汇编;
+    void genGlobal(const koopa_raw_value_t &value);
+    // 生成的汇编, 由调用者写出;
+    string &result() { return riscv_ret_str; }
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "compiler.hpp"
+#include "ast.hpp"
+#include "code_gen.hpp"
+#include "context.hpp"
+#include "dce.hpp"
+#include "gvn.hpp"
+#include "layout.hpp"
+#include "licm.hpp"
+#include "mem2reg.hpp"
+#include "simplify.hpp"
+#include <memory>
+
+// flex 生成的可重入 lexer 的接口, scanner 即 yyscan_t, yyextra 是存放标识符的 arena;
+struct yy_buffer_state;
+int yylex_init_extra(Arena *arena, void **scanner);
+yy_buffer_state *yy_scan_string(const char *str, void *scanner);
+int yylex_destroy(void *scanner);
+int yyparse(BaseAST *&ast, void *scanner, Arena &ast_arena);
+
+// -O1 的优化 pass, 依次作用于一个函数: 把标量局部变量提升为 SSA 值, 化简, 删除冗余计算,
+// 外提循环不变量, 删除死代码, 最后排布基本块; 每个 pass 的统计追加到 stats;
+static void _optimize(const koopa_raw_function_t &func, IRBuilder &ir_builder, vector<PassStats> &stats)
+{
+    stats.push_back(mem2reg(func, ir_builder));
+    stats.push_back(simplify(func, ir_builder));
+    stats.push_back(gvn(func, ir_builder));
+    stats.push_back(licm(func, ir_builder));
+    stats.push_back(dce(func, ir_builder));
+    stats.push_back(layoutBlocks(func, ir_builder));
+}
+
+// 结果写到已经打开的 ctx.out;
+static bool _compile(CompileContext &ctx, const string &source)
+{
+    const CompileOptions &options = ctx.options;
+
+    // 直接从内存中的源程序解析
+    void *scanner;
+    yylex_init_extra(&ctx.ast_arena, &scanner);
+    yy_scan_string(source.c_str(), scanner);
+    BaseAST *ast = nullptr;
+    int ret = yyparse(ast, scanner, ctx.ast_arena);
+    yylex_destroy(scanner);
+    if (ret)
+        return false;
+
+    // 遍历 AST, 直接在内存中构建 raw program
+    ast->Dump(ctx);
+    koopa_raw_program_t raw = ctx.ir_builder.build();
+
+    // raw program 不引用 AST, 整棵树连同标识符一次性释放
+    ast = nullptr;
+    ctx.ast_arena.clear();
+
+    // -O1 时逐个函数运行优化 pass, 函数之间互不影响, 统计按函数分开存放, 最后按顺序输出
+    vector<vector<PassStats>> stats(raw.funcs.len);
+    auto optimize = [&](size_t i)
+    {
+        auto func = reinterpret_cast<koopa_raw_function_t>(raw.funcs.buffer[i]);
+        if (options.opt >= 1 && func->bbs.len != 0)
+            _optimize(func, ctx.ir_builder, stats[i]);
+    };
+    unique_ptr<ThreadPool> pool;
+    if (options.jobs > 1)
+        pool = make_unique<ThreadPool>(options.jobs);
+
+    if (options.mode == MODE_KOOPA)
+    {
+        if (pool)
+        {
+            for (size_t i = 0; i < raw.funcs.len; ++i)
+                pool->submit([&optimize, i]
+                             { optimize(i); });
+            pool->wait();
+        }
+        else
+        {
+            for (size_t i = 0; i < raw.funcs.len; ++i)
+                optimize(i);
+        }
+
+
+        // 只有需要输出 Koopa IR 文本时才把 raw program 转换回 Koopa IR 程序
+        koopa_program_t program;
+        koopa_error_code_t ret = koopa_generate_raw_to_koopa(&raw, &program);
+        assert(ret == KOOPA_EC_SUCCESS);
+        size_t len = 0;
+        ret = koopa_dump_to_string(program, nullptr, &len);
+        assert(ret == KOOPA_EC_SUCCESS);
+        string koopa_str(len, '\0');
+        ret = koopa_dump_to_string(program, koopa_str.data(), &len);
+        assert(ret == KOOPA_EC_SUCCESS);
+        koopa_delete_program(program);
+        koopa_str.resize(strlen(koopa_str.c_str()));
+        ctx.out.write(koopa_str);
+    }
+    else
+    {
+        // 处理 raw program, 每个函数优化后立即生成汇编并写出, 不在内存中拼接整个程序
+        // raw program 中所有的指针指向的内存均为 ctx.ir_builder 的内存
+        Visit(raw, ctx.out, options.opt, pool.get(), optimize);
+    }
+    ctx.out.write("\n");
+    ctx.out.flush();
+
+    if (options.stats)
+    {
+        for (auto &func_stats : stats)
+        {
+            for (auto &s : func_stats)
+                cerr << s << endl;
+        }
+    }
+    return ctx.out.ok();
+}
+
+bool compile(const string &source, const CompileOptions &options, int fd)
+{
+    CompileContext ctx(options);
+    ctx.out.open(fd);
+    return _compile(ctx, source);
+}
+
+bool compile(const string &source, const CompileOptions &options, string &output)
+{
+    CompileContext ctx(options);
+    ctx.out.open(&output);
+    return _compile(ctx, source);
+}
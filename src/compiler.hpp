@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+enum CompileMode
+{
+    MODE_KOOPA, // 输出 Koopa IR 文本;
+    MODE_RISCV, // 输出 RISC-V 汇编;
+};
+
+struct CompileOptions
+{
+    CompileMode mode = MODE_RISCV;
+    int opt = 0;        // 优化级别, 1 时运行优化 pass;
+    int jobs = 1;       // 大于 1 时后端用 jobs 个线程并行生成各个函数, 输出与串行生成相同;
+    bool stats = false; // 在 stderr 输出每个优化 pass 在每个函数上的统计;
+};
+
+// 编译一段 SysY 源程序, 源程序有语法错误或写出结果失败时返回 false;
+// 语义错误 (未定义或重复定义的符号等) 不返回 false, 而是 assert 终止进程;
+// 编译用到的状态 (AST, IR, 符号表, 栈帧等) 都在这次调用自己创建的 CompileContext 中, 返回时释放,
+// 调用之间不共享可变状态, 同一个进程可以依次编译多个程序, 不同线程也可以同时编译;
+// 结果写到文件描述符 fd;
+bool compile(const string &source, const CompileOptions &options, int fd);
+// 库接口: 结果追加到 output;
+bool compile(const string &source, const CompileOptions &options, string &output);
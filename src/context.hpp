@@ -0,0 +1,46 @@
+#pragma once
+
+#include "koopa.h"
+#include "arena.hpp"
+#include "compiler.hpp"
+#include "ir_builder.hpp"
+#include "output.hpp"
+#include "symbol_table.hpp"
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// 一次 compile() 用到的全部状态, 由 compile() 创建, 沿着解析, 生成 IR, 优化和代码生成向下传递, 编译结束时一起释放;
+// 不同的 compile() 之间没有共享的可变状态;
+struct CompileContext
+{
+    CompileOptions options;
+    Arena ast_arena;      // AST 节点和标识符, 生成 IR 后一次性释放;
+    IRBuilder ir_builder; // raw program 的所有结构体都属于它;
+    OutputWriter out;     // Koopa IR 文本或汇编的输出;
+
+    // 前端生成 IR 时的状态;
+    int if_label_no = 0;  // 下一个可用的if_label的编号;
+    int zero_loop_no = 0; // 下一个可用的局部数组清零循环的编号;
+
+    int cur_basic_block = 0; // 用于判断当前程序块是否已经生成了br, jump或ret指令;
+    unordered_map<int, bool> is_end;
+
+    int while_label_no = 0;   // 下一个可用的while_label的编号;
+    int cur_while_level = -1; // 现在所处位置的while_label编号;
+    unordered_map<int, int> while_parent;
+
+    int cur_scope = 0; // 现在所处的作用域;
+    unordered_map<int, int> scope_parent;
+
+    string cur_func_type;
+
+    SymbolTableStack symbol_table;
+
+    // 用于 break / continue 跳转;
+    unordered_map<int, koopa_raw_basic_block_t> while_cond_bb;
+    unordered_map<int, koopa_raw_basic_block_t> while_end_bb;
+
+    CompileContext(const CompileOptions &_options) : options(_options) {}
+};
@@ -0,0 +1,402 @@
+#include "dce.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+static koopa_raw_value_t _slice_value(const koopa_raw_slice_t &slice, size_t i)
+{
+    return reinterpret_cast<koopa_raw_value_t>(slice.buffer[i]);
+}
+
+static koopa_raw_value_t _term(const koopa_raw_basic_block_t &bb)
+{
+    return _slice_value(bb->insts, bb->insts.len - 1);
+}
+
+static koopa_raw_basic_block_data_t *_mut(const koopa_raw_basic_block_t &bb)
+{
+    return const_cast<koopa_raw_basic_block_data_t *>(bb);
+}
+
+// 终结指令的一条出边, 目标和实参都可以原地修改;
+struct Edge
+{
+    koopa_raw_basic_block_t *target;
+    koopa_raw_slice_t *args;
+};
+
+static void _edges(const koopa_raw_value_t &term, vector<Edge> &edges)
+{
+    edges.clear();
+    auto &kind = const_cast<koopa_raw_value_data_t *>(term)->kind;
+    if (kind.tag == KOOPA_RVT_JUMP)
+        edges.push_back({&kind.data.jump.target, &kind.data.jump.args});
+    else if (kind.tag == KOOPA_RVT_BRANCH)
+    {
+        edges.push_back({&kind.data.branch.true_bb, &kind.data.branch.true_args});
+        edges.push_back({&kind.data.branch.false_bb, &kind.data.branch.false_args});
+    }
+}
+
+static bool _same_args(const koopa_raw_slice_t &a, const koopa_raw_slice_t &b)
+{
+    if (a.len != b.len)
+        return false;
+    for (size_t i = 0; i < a.len; ++i)
+    {
+        if (a.buffer[i] != b.buffer[i])
+            return false;
+    }
+    return true;
+}
+
+// 从入口出发删除不可达的基本块;
+static int _remove_unreachable(vector<koopa_raw_basic_block_t> &bbs)
+{
+    unordered_set<koopa_raw_basic_block_t> reached{bbs[0]};
+    vector<koopa_raw_basic_block_t> stack{bbs[0]}, succs;
+    while (!stack.empty())
+    {
+        auto bb = stack.back();
+        stack.pop_back();
+        getSuccessors(bb, succs);
+        for (auto s : succs)
+        {
+            if (reached.insert(s).second)
+                stack.push_back(s);
+        }
+    }
+    size_t n = bbs.size();
+    bbs.erase(remove_if(bbs.begin(), bbs.end(), [&](koopa_raw_basic_block_t bb)
+                        { return !reached.count(bb); }),
+              bbs.end());
+    return n - bbs.size();
+}
+
+// 条件为常量或两个目标和实参都相同的 branch 改为 jump;
+static bool _fold_branches(const vector<koopa_raw_basic_block_t> &bbs)
+{
+    bool changed = false;
+    for (auto bb : bbs)
+    {
+        auto &kind = const_cast<koopa_raw_value_data_t *>(_term(bb))->kind;
+        if (kind.tag != KOOPA_RVT_BRANCH)
+            continue;
+        auto branch = kind.data.branch;
+        bool taken;
+        if (branch.cond->kind.tag == KOOPA_RVT_INTEGER)
+            taken = branch.cond->kind.data.integer.value != 0;
+        else if (branch.true_bb == branch.false_bb && _same_args(branch.true_args, branch.false_args))
+            taken = true;
+        else
+            continue;
+        kind.tag = KOOPA_RVT_JUMP;
+        kind.data.jump.target = taken ? branch.true_bb : branch.false_bb;
+        kind.data.jump.args = taken ? branch.true_args : branch.false_args;
+        changed = true;
+    }
+    return changed;
+}
+
+// 只有一条 jump 的基本块 B 被绕过: 前驱改为直接跳到 B 的目标 C, B 的参数替换为前驱传来的实参;
+// 要求 B 的参数只在这条 jump 中使用, C 本身不是只有一条 jump 的基本块 (避免在环上来回改写);
+static bool _thread_jumps(const vector<koopa_raw_basic_block_t> &bbs, IRBuilder &ir_builder)
+{
+    auto jump_only = [](koopa_raw_basic_block_t bb)
+    {
+        return bb->insts.len == 1 && _term(bb)->kind.tag == KOOPA_RVT_JUMP;
+    };
+
+    unordered_map<koopa_raw_value_t, int> uses;
+    vector<koopa_raw_value_t> ops;
+    for (auto bb : bbs)
+    {
+        for (size_t i = 0; i < bb->insts.len; ++i)
+        {
+            getOperands(_slice_value(bb->insts, i), ops);
+            for (auto op : ops)
+                uses[op]++;
+        }
+    }
+
+    bool changed = false;
+    vector<Edge> edges;
+    for (auto pred : bbs)
+    {
+        _edges(_term(pred), edges);
+        for (auto &edge : edges)
+        {
+            auto b = *edge.target;
+            if (b == bbs[0] || !jump_only(b))
+                continue;
+            const auto &jump = _term(b)->kind.data.jump;
+            auto c = jump.target;
+            if (c == b || jump_only(c))
+                continue;
+
+            unordered_map<koopa_raw_value_t, koopa_raw_value_t> subst;
+            for (size_t k = 0; k < b->params.len; ++k)
+                subst[_slice_value(b->params, k)] = _slice_value(*edge.args, k);
+            bool local = true;
+            for (auto &p : subst)
+            {
+                int in_jump = 0;
+                for (size_t k = 0; k < jump.args.len; ++k)
+                    in_jump += _slice_value(jump.args, k) == p.first;
+                local &= uses[p.first] == in_jump;
+            }
+            if (!local)
+                continue;
+
+            vector<const void *> args;
+            for (size_t k = 0; k < jump.args.len; ++k)
+            {
+                auto arg = _slice_value(jump.args, k);
+                auto it = subst.find(arg);
+                args.push_back(it == subst.end() ? arg : it->second);
+            }
+            *edge.target = c;
+            *edge.args = ir_builder.slice(args, KOOPA_RSIK_VALUE);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// 以 jump 结尾的基本块 A 和它的目标 B 合并, 要求 A 是 B 唯一的前驱 (只有一条边);
+// B 的参数替换为实参, 替换记录在 replace 中, 由调用者统一改写;
+static int _merge_blocks(vector<koopa_raw_basic_block_t> &bbs, unordered_map<koopa_raw_value_t, koopa_raw_value_t> &replace,
+                         IRBuilder &ir_builder)
+{
+    unordered_map<koopa_raw_basic_block_t, int> pred_edges;
+    vector<Edge> edges;
+    for (auto bb : bbs)
+    {
+        _edges(_term(bb), edges);
+        for (auto &edge : edges)
+            pred_edges[*edge.target]++;
+    }
+
+    unordered_set<koopa_raw_basic_block_t> merged;
+    int removed = 0;
+    for (auto a : bbs)
+    {
+        if (merged.count(a))
+            continue;
+        for (;;)
+        {
+            auto term = _term(a);
+            if (term->kind.tag != KOOPA_RVT_JUMP)
+                break;
+            auto b = term->kind.data.jump.target;
+            if (b == a || b == bbs[0] || pred_edges[b] != 1)
+                break;
+            const auto &args = term->kind.data.jump.args;
+            for (size_t k = 0; k < b->params.len; ++k)
+                replace[_slice_value(b->params, k)] = _slice_value(args, k);
+
+            vector<const void *> insts(a->insts.buffer, a->insts.buffer + a->insts.len - 1);
+            insts.insert(insts.end(), b->insts.buffer, b->insts.buffer + b->insts.len);
+            _mut(a)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+            merged.insert(b);
+            removed++;
+        }
+    }
+    bbs.erase(remove_if(bbs.begin(), bbs.end(), [&](koopa_raw_basic_block_t bb)
+                        { return merged.count(bb) > 0; }),
+              bbs.end());
+    return removed;
+}
+
+// 地址的来源: 沿 getelemptr/getptr 的 src 找到的 alloc, 不是局部数组时返回 nullptr;
+static koopa_raw_value_t _addr_root(koopa_raw_value_t v)
+{
+    while (v->kind.tag == KOOPA_RVT_GET_ELEM_PTR || v->kind.tag == KOOPA_RVT_GET_PTR)
+        v = v->kind.tag == KOOPA_RVT_GET_ELEM_PTR ? v->kind.data.get_elem_ptr.src : v->kind.data.get_ptr.src;
+    return v->kind.tag == KOOPA_RVT_ALLOC ? v : nullptr;
+}
+
+// 标记-清除: 返回删除的指令数, params 累加删除的基本块参数数;
+static int _sweep(const vector<koopa_raw_basic_block_t> &bbs, int &params, IRBuilder &ir_builder)
+{
+    // 只作为 store 的目标 (直接或经过 getelemptr/getptr) 出现的局部变量, 写入它的 store 不是活跃的根;
+    unordered_set<koopa_raw_value_t> read_allocs;
+    vector<koopa_raw_value_t> ops;
+    for (auto bb : bbs)
+    {
+        for (size_t i = 0; i < bb->insts.len; ++i)
+        {
+            auto inst = _slice_value(bb->insts, i);
+            getOperands(inst, ops);
+            for (size_t k = 0; k < ops.size(); ++k)
+            {
+                auto root = _addr_root(ops[k]);
+                if (!root)
+                    continue;
+                bool write = (inst->kind.tag == KOOPA_RVT_STORE && k == 1) ||
+                             ((inst->kind.tag == KOOPA_RVT_GET_ELEM_PTR || inst->kind.tag == KOOPA_RVT_GET_PTR) && k == 0);
+                if (!write)
+                    read_allocs.insert(root);
+            }
+        }
+    }
+
+    // 基本块参数 -> (基本块, 下标), 基本块 -> 入边;
+    unordered_map<koopa_raw_value_t, pair<koopa_raw_basic_block_t, size_t>> param_of;
+    unordered_map<koopa_raw_basic_block_t, vector<Edge>> in_edges;
+    vector<Edge> edges;
+    for (auto bb : bbs)
+    {
+        for (size_t k = 0; k < bb->params.len; ++k)
+            param_of[_slice_value(bb->params, k)] = {bb, k};
+        _edges(_term(bb), edges);
+        for (auto &edge : edges)
+            in_edges[*edge.target].push_back(edge);
+    }
+
+    unordered_set<koopa_raw_value_t> live;
+    vector<koopa_raw_value_t> worklist;
+    auto mark = [&](koopa_raw_value_t v)
+    {
+        if (live.insert(v).second)
+            worklist.push_back(v);
+    };
+
+    // 有副作用的指令是根, 终结指令的实参随目标的参数一起标记;
+    for (auto bb : bbs)
+    {
+        for (size_t i = 0; i < bb->insts.len; ++i)
+        {
+            auto inst = _slice_value(bb->insts, i);
+            const auto &kind = inst->kind;
+            switch (kind.tag)
+            {
+            case KOOPA_RVT_STORE:
+            {
+                auto root = _addr_root(kind.data.store.dest);
+                if (!root || read_allocs.count(root))
+                    mark(inst);
+                break;
+            }
+            case KOOPA_RVT_CALL:
+            case KOOPA_RVT_RETURN:
+                mark(inst);
+                break;
+            case KOOPA_RVT_BRANCH:
+                live.insert(inst);
+                mark(kind.data.branch.cond);
+                break;
+            case KOOPA_RVT_JUMP:
+                live.insert(inst);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    while (!worklist.empty())
+    {
+        auto v = worklist.back();
+        worklist.pop_back();
+        auto it = param_of.find(v);
+        if (it != param_of.end())
+        {
+            for (auto &edge : in_edges[it->second.first])
+                mark(_slice_value(*edge.args, it->second.second));
+            continue;
+        }
+        getOperands(v, ops);
+        for (auto op : ops)
+            mark(op);
+    }
+
+    // 删除不活跃的指令;
+    int removed = 0;
+    for (auto bb : bbs)
+    {
+        vector<const void *> insts;
+        for (size_t i = 0; i < bb->insts.len; ++i)
+        {
+            auto inst = _slice_value(bb->insts, i);
+            if (live.count(inst))
+                insts.push_back(inst);
+        }
+        if (insts.size() != bb->insts.len)
+        {
+            removed += bb->insts.len - insts.size();
+            _mut(bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+        }
+    }
+
+    // 删除不活跃的基本块参数和所有入边上对应的实参, 剩下的参数重新编号;
+    for (auto bb : bbs)
+    {
+        vector<size_t> keep;
+        for (size_t k = 0; k < bb->params.len; ++k)
+        {
+            if (live.count(_slice_value(bb->params, k)))
+                keep.push_back(k);
+        }
+        if (keep.size() == bb->params.len)
+            continue;
+        params += bb->params.len - keep.size();
+        auto select = [&](const koopa_raw_slice_t &slice)
+        {
+            vector<const void *> items;
+            for (auto k : keep)
+                items.push_back(slice.buffer[k]);
+            return ir_builder.slice(items, KOOPA_RSIK_VALUE);
+        };
+        for (auto &edge : in_edges[bb])
+            *edge.args = select(*edge.args);
+        _mut(bb)->params = select(bb->params);
+        for (size_t k = 0; k < keep.size(); ++k)
+            const_cast<koopa_raw_value_data_t *>(_slice_value(bb->params, k))->kind.data.block_arg_ref.index = k;
+    }
+    return removed;
+}
+
+PassStats dce(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    int insts = 0, blocks = 0, params = 0;
+    vector<koopa_raw_basic_block_t> bbs;
+    for (size_t i = 0; i < func->bbs.len; ++i)
+        bbs.push_back(reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]));
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = _fold_branches(bbs);
+        int unreachable = _remove_unreachable(bbs);
+        changed |= _thread_jumps(bbs, ir_builder);
+        unordered_map<koopa_raw_value_t, koopa_raw_value_t> replace;
+        int merged = _merge_blocks(bbs, replace, ir_builder);
+        if (!replace.empty())
+        {
+            auto resolve = [&](koopa_raw_value_t v)
+            {
+                for (auto it = replace.find(v); it != replace.end(); it = replace.find(v))
+                    v = it->second;
+                return v;
+            };
+            for (auto bb : bbs)
+            {
+                for (size_t i = 0; i < bb->insts.len; ++i)
+                    replaceOperands(_slice_value(bb->insts, i), resolve);
+            }
+        }
+        int swept = _sweep(bbs, params, ir_builder);
+        blocks += unreachable + merged;
+        insts += merged + swept;
+        changed |= unreachable || merged || swept;
+    }
+
+    const_cast<koopa_raw_function_data_t *>(func)->bbs = ir_builder.slice(vector<const void *>(bbs.begin(), bbs.end()), KOOPA_RSIK_BASIC_BLOCK);
+
+    PassStats stats("dce", func);
+    stats.add("insts", insts);
+    stats.add("blocks", blocks);
+    stats.add("params", params);
+    return stats;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 死代码删除和控制流图化简, -O1 时在 licm 之后运行, 反复执行直到不再变化:
+// 删除不可达的基本块; 条件为常量或两个目标相同的 branch 改为 jump;
+// 只有一条 jump 的基本块被绕过, 前驱直接跳到它的目标;
+// 以 jump 结尾的基本块和它唯一前驱的后继合并, 基本块参数替换为实参;
+// 从有副作用的指令出发标记活跃的值, 删除没有被使用的纯计算 (binary, load, getelemptr, getptr),
+// 没有被使用的基本块参数和对应的实参, 以及只被写入从不被读取的局部数组;
+// 统计删除的指令数 (insts), 基本块数 (blocks) 和基本块参数数 (params);
+PassStats dce(const koopa_raw_function_t &func, IRBuilder &ir_builder);
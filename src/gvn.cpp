@@ -0,0 +1,146 @@
+#include "gvn.hpp"
+#include "simplify.hpp"
+#include <functional>
+#include <unordered_map>
+
+// 纯计算的值编号: 指令类型, 运算和两个操作数;
+struct ExprKey
+{
+    koopa_raw_value_tag_t tag;
+    int op;
+    koopa_raw_value_t lhs, rhs;
+    bool operator==(const ExprKey &o) const
+    {
+        return tag == o.tag && op == o.op && lhs == o.lhs && rhs == o.rhs;
+    }
+};
+
+struct ExprKeyHash
+{
+    size_t operator()(const ExprKey &key) const
+    {
+        size_t h = hash<const void *>()(key.lhs);
+        h = h * 31 + hash<const void *>()(key.rhs);
+        return h * 31 + (key.tag << 8 | key.op);
+    }
+};
+
+// 指令的值编号, 不是纯计算时返回 false;
+// 可交换的运算把操作数按地址排序, 比较运算同时翻转, a < b 和 b > a 得到相同的编号;
+static bool _expr_key(const koopa_raw_value_t &inst, ExprKey &key)
+{
+    auto &kind = inst->kind;
+    key.tag = kind.tag;
+    switch (kind.tag)
+    {
+    case KOOPA_RVT_BINARY:
+    {
+        auto op = kind.data.binary.op;
+        key.op = op;
+        key.lhs = kind.data.binary.lhs;
+        key.rhs = kind.data.binary.rhs;
+        koopa_raw_binary_op_t swapped;
+        if (key.lhs > key.rhs && swapBinaryOp(op, swapped))
+        {
+            swap(key.lhs, key.rhs);
+            key.op = swapped;
+        }
+        return true;
+    }
+    case KOOPA_RVT_GET_ELEM_PTR:
+        key.op = 0;
+        key.lhs = kind.data.get_elem_ptr.src;
+        key.rhs = kind.data.get_elem_ptr.index;
+        return true;
+    case KOOPA_RVT_GET_PTR:
+        key.op = 0;
+        key.lhs = kind.data.get_ptr.src;
+        key.rhs = kind.data.get_ptr.index;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 对一个函数做值编号, 返回删除的指令数;
+static int _gvn_func(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    unordered_map<ExprKey, koopa_raw_value_t, ExprKeyHash> table;
+    unordered_map<koopa_raw_value_t, koopa_raw_value_t> replace;
+    auto resolve = [&](koopa_raw_value_t v)
+    {
+        auto it = replace.find(v);
+        return it == replace.end() ? v : it->second;
+    };
+
+    // 支配树先序遍历, 值的使用 (包括传给后继的实参) 总是在它的定义之后被访问;
+    // 离开子树时按记录撤销这棵子树加入哈希表的项;
+    int removed = 0;
+    vector<ExprKey> added;
+    vector<pair<int, size_t>> stack{{0, 0}};
+    vector<size_t> marks;
+    while (!stack.empty())
+    {
+        auto &top = stack.back();
+        int b = top.first;
+        if (top.second == 0)
+        {
+            marks.push_back(added.size());
+            auto bb = cfg.bbs[b];
+            vector<const void *> insts;
+            for (size_t i = 0; i < bb->insts.len; ++i)
+            {
+                auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[i]);
+                replaceOperands(inst, resolve);
+                ExprKey key;
+                if (_expr_key(inst, key))
+                {
+                    auto it = table.find(key);
+                    if (it != table.end())
+                    {
+                        replace[inst] = it->second;
+                        removed++;
+                        continue;
+                    }
+                    table.emplace(key, inst);
+                    added.push_back(key);
+                }
+                insts.push_back(inst);
+            }
+            if (insts.size() != bb->insts.len)
+                const_cast<koopa_raw_basic_block_data_t *>(bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+        }
+        if (top.second < cfg.dom_children[b].size())
+        {
+            int child = cfg.dom_children[b][top.second++];
+            stack.emplace_back(child, 0);
+        }
+        else
+        {
+            for (size_t i = marks.back(); i < added.size(); ++i)
+                table.erase(added[i]);
+            added.resize(marks.back());
+            marks.pop_back();
+            stack.pop_back();
+        }
+    }
+
+    // 不可达的基本块不在支配树上, 也要替换其中对被删除指令的引用;
+    for (size_t b = 0; b < cfg.bbs.size(); ++b)
+    {
+        if (cfg.reachable(b))
+            continue;
+        for (size_t i = 0; i < cfg.bbs[b]->insts.len; ++i)
+            replaceOperands(reinterpret_cast<koopa_raw_value_t>(cfg.bbs[b]->insts.buffer[i]), resolve);
+    }
+
+    return removed;
+}
+
+PassStats gvn(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    PassStats stats("gvn", func);
+    stats.add("removed", _gvn_func(func, ir_builder));
+    return stats;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 基于支配树的全局值编号, -O1 时在 simplify 之后运行;
+// 沿支配树先序遍历, 用作用域化的哈希表记录支配当前基本块的纯计算 (binary, getelemptr, getptr),
+// 运算和操作数都相同的指令被支配它的等价指令替代, 可交换的运算不区分操作数顺序;
+// load 的结果依赖内存状态, 不参与编号;
+// 统计删除的指令数 (removed);
+PassStats gvn(const koopa_raw_function_t &func, IRBuilder &ir_builder);
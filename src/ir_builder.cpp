@@ -0,0 +1,341 @@
+#include "ir_builder.hpp"
+
+const char *IRBuilder::newName(const string &name)
+{
+    if (name.empty())
+        return nullptr;
+    lock_guard<mutex> lock(arena_lock);
+    return arena.newStr(name.c_str(), name.size());
+}
+
+koopa_raw_slice_t IRBuilder::slice(const vector<const void *> &items, koopa_raw_slice_item_kind_t kind)
+{
+    koopa_raw_slice_t ret;
+    ret.kind = kind;
+    ret.len = items.size();
+    ret.buffer = nullptr;
+    if (!items.empty())
+    {
+        lock_guard<mutex> lock(arena_lock);
+        ret.buffer = static_cast<const void **>(arena.alloc(sizeof(const void *) * items.size(), alignof(const void *)));
+        memcpy(ret.buffer, items.data(), sizeof(const void *) * items.size());
+    }
+    return ret;
+}
+
+koopa_raw_value_data_t *IRBuilder::newValue(koopa_raw_type_t ty, const string &name, koopa_raw_value_tag_t tag)
+{
+    auto value = make<koopa_raw_value_data_t>();
+    value->ty = ty;
+    value->name = newName(name);
+    value->used_by = slice({}, KOOPA_RSIK_VALUE);
+    value->kind.tag = tag;
+    return value;
+}
+
+koopa_raw_value_data_t *IRBuilder::newInst(koopa_raw_type_t ty, koopa_raw_value_tag_t tag, const string &name)
+{
+    assert(cur_bb);
+    auto inst = newValue(ty, name, tag);
+    cur_insts.push_back(inst);
+    return inst;
+}
+
+IRBuilder::IRBuilder()
+{
+    clear();
+}
+
+void IRBuilder::clear()
+{
+    arena.clear();
+    int_table.clear();
+    values.clear();
+    funcs.clear();
+    func_table.clear();
+    var_table.clear();
+    cur_func = nullptr;
+    cur_params.clear();
+    cur_bbs.clear();
+    cur_allocs.clear();
+    cur_bb = nullptr;
+    cur_insts.clear();
+
+    auto i32 = make<koopa_raw_type_kind_t>();
+    i32->tag = KOOPA_RTT_INT32;
+    int32_ty = i32;
+    auto unit = make<koopa_raw_type_kind_t>();
+    unit->tag = KOOPA_RTT_UNIT;
+    unit_ty = unit;
+}
+
+koopa_raw_type_t IRBuilder::arrayType(koopa_raw_type_t base, size_t len)
+{
+    auto ty = make<koopa_raw_type_kind_t>();
+    ty->tag = KOOPA_RTT_ARRAY;
+    ty->data.array.base = base;
+    ty->data.array.len = len;
+    return ty;
+}
+
+koopa_raw_type_t IRBuilder::pointerType(koopa_raw_type_t base)
+{
+    auto ty = make<koopa_raw_type_kind_t>();
+    ty->tag = KOOPA_RTT_POINTER;
+    ty->data.pointer.base = base;
+    return ty;
+}
+
+koopa_raw_value_t IRBuilder::integer(int val)
+{
+    lock_guard<mutex> lock(int_lock);
+    auto it = int_table.find(val);
+    if (it != int_table.end())
+        return it->second;
+    auto value = newValue(int32_ty, "", KOOPA_RVT_INTEGER);
+    value->kind.data.integer.value = val;
+    int_table[val] = value;
+    return value;
+}
+
+koopa_raw_value_t IRBuilder::zeroInit(koopa_raw_type_t ty)
+{
+    return newValue(ty, "", KOOPA_RVT_ZERO_INIT);
+}
+
+koopa_raw_value_t IRBuilder::aggregate(koopa_raw_type_t ty, const vector<const void *> &elems)
+{
+    auto value = newValue(ty, "", KOOPA_RVT_AGGREGATE);
+    value->kind.data.aggregate.elems = slice(elems, KOOPA_RSIK_VALUE);
+    return value;
+}
+
+koopa_raw_value_t IRBuilder::undef(koopa_raw_type_t ty)
+{
+    return newValue(ty, "", KOOPA_RVT_UNDEF);
+}
+
+koopa_raw_function_t IRBuilder::declFunc(const string &name, const vector<koopa_raw_type_t> &params, koopa_raw_type_t ret)
+{
+    auto ty = make<koopa_raw_type_kind_t>();
+    ty->tag = KOOPA_RTT_FUNCTION;
+    ty->data.function.params = slice(vector<const void *>(params.begin(), params.end()), KOOPA_RSIK_TYPE);
+    ty->data.function.ret = ret;
+
+    auto func = make<koopa_raw_function_data_t>();
+    func->ty = ty;
+    func->name = newName(name);
+    func->params = slice({}, KOOPA_RSIK_VALUE);
+    func->bbs = slice({}, KOOPA_RSIK_BASIC_BLOCK);
+
+    funcs.push_back(func);
+    func_table[name] = func;
+    return func;
+}
+
+koopa_raw_function_t IRBuilder::beginFunc(const string &name, koopa_raw_type_t ret)
+{
+    assert(!cur_func);
+    // 参数类型在 endFunc 时补全, 函数体内的递归调用只需要返回类型;
+    cur_func = const_cast<koopa_raw_function_data_t *>(declFunc(name, {}, ret));
+    cur_params.clear();
+    cur_bbs.clear();
+    cur_allocs.clear();
+    return cur_func;
+}
+
+koopa_raw_value_t IRBuilder::addParam(const string &name, koopa_raw_type_t ty)
+{
+    assert(cur_func && cur_bbs.empty());
+    auto param = newValue(ty, name, KOOPA_RVT_FUNC_ARG_REF);
+    param->kind.data.func_arg_ref.index = cur_params.size();
+    cur_params.push_back(param);
+    return param;
+}
+
+koopa_raw_value_t IRBuilder::getParam(size_t idx)
+{
+    assert(idx < cur_params.size());
+    return reinterpret_cast<koopa_raw_value_t>(cur_params[idx]);
+}
+
+void IRBuilder::finishBlock()
+{
+    if (cur_bb)
+        cur_bb->insts = slice(cur_insts, KOOPA_RSIK_VALUE);
+    cur_bb = nullptr;
+    cur_insts.clear();
+}
+
+void IRBuilder::endFunc()
+{
+    assert(cur_func && !cur_bbs.empty());
+    finishBlock();
+
+    if (!cur_allocs.empty())
+    {
+        auto entry = const_cast<koopa_raw_basic_block_data_t *>(reinterpret_cast<koopa_raw_basic_block_t>(cur_bbs[0]));
+        cur_allocs.insert(cur_allocs.end(), entry->insts.buffer, entry->insts.buffer + entry->insts.len);
+        entry->insts = slice(cur_allocs, KOOPA_RSIK_VALUE);
+        cur_allocs.clear();
+    }
+
+    vector<const void *> param_tys;
+    for (auto param : cur_params)
+        param_tys.push_back(reinterpret_cast<koopa_raw_value_t>(param)->ty);
+    auto ty = const_cast<koopa_raw_type_kind_t *>(cur_func->ty);
+    ty->data.function.params = slice(param_tys, KOOPA_RSIK_TYPE);
+
+    cur_func->params = slice(cur_params, KOOPA_RSIK_VALUE);
+    cur_func->bbs = slice(cur_bbs, KOOPA_RSIK_BASIC_BLOCK);
+    cur_func = nullptr;
+}
+
+koopa_raw_function_t IRBuilder::getFunc(const string &name)
+{
+    assert(func_table.find(name) != func_table.end());
+    return func_table[name];
+}
+
+koopa_raw_basic_block_t IRBuilder::newBlock(const string &name)
+{
+    auto bb = make<koopa_raw_basic_block_data_t>();
+    bb->name = newName(name);
+    bb->params = slice({}, KOOPA_RSIK_VALUE);
+    bb->used_by = slice({}, KOOPA_RSIK_VALUE);
+    bb->insts = slice({}, KOOPA_RSIK_VALUE);
+    return bb;
+}
+
+void IRBuilder::setBlock(koopa_raw_basic_block_t bb)
+{
+    assert(cur_func);
+    finishBlock();
+    cur_bb = const_cast<koopa_raw_basic_block_data_t *>(bb);
+    cur_bbs.push_back(bb);
+}
+
+koopa_raw_value_t IRBuilder::blockParam(const string &name, koopa_raw_type_t ty, size_t index)
+{
+    auto param = newValue(ty, name, KOOPA_RVT_BLOCK_ARG_REF);
+    param->kind.data.block_arg_ref.index = index;
+    return param;
+}
+
+koopa_raw_value_t IRBuilder::jumpTo(koopa_raw_basic_block_t target, const vector<const void *> &args)
+{
+    auto inst = newValue(unit_ty, "", KOOPA_RVT_JUMP);
+    inst->kind.data.jump.target = target;
+    inst->kind.data.jump.args = slice(args, KOOPA_RSIK_VALUE);
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::globalAlloc(const string &name, koopa_raw_type_t ty, koopa_raw_value_t init)
+{
+    auto value = newValue(pointerType(ty), name, KOOPA_RVT_GLOBAL_ALLOC);
+    value->kind.data.global_alloc.init = init;
+    values.push_back(value);
+    var_table[name] = value;
+    return value;
+}
+
+koopa_raw_value_t IRBuilder::alloc(const string &name, koopa_raw_type_t ty)
+{
+    assert(cur_func);
+    auto inst = newValue(pointerType(ty), name, KOOPA_RVT_ALLOC);
+    cur_allocs.push_back(inst);
+    var_table[name] = inst;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::getVar(const string &name)
+{
+    assert(var_table.find(name) != var_table.end());
+    return var_table[name];
+}
+
+koopa_raw_value_t IRBuilder::load(koopa_raw_value_t src)
+{
+    assert(src->ty->tag == KOOPA_RTT_POINTER);
+    auto inst = newInst(src->ty->data.pointer.base, KOOPA_RVT_LOAD);
+    inst->kind.data.load.src = src;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::store(koopa_raw_value_t value, koopa_raw_value_t dest)
+{
+    auto inst = newInst(unit_ty, KOOPA_RVT_STORE);
+    inst->kind.data.store.value = value;
+    inst->kind.data.store.dest = dest;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::getPtr(koopa_raw_value_t src, koopa_raw_value_t index)
+{
+    assert(src->ty->tag == KOOPA_RTT_POINTER);
+    auto inst = newInst(src->ty, KOOPA_RVT_GET_PTR);
+    inst->kind.data.get_ptr.src = src;
+    inst->kind.data.get_ptr.index = index;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::getElemPtr(koopa_raw_value_t src, koopa_raw_value_t index)
+{
+    assert(src->ty->tag == KOOPA_RTT_POINTER && src->ty->data.pointer.base->tag == KOOPA_RTT_ARRAY);
+    auto inst = newInst(pointerType(src->ty->data.pointer.base->data.array.base), KOOPA_RVT_GET_ELEM_PTR);
+    inst->kind.data.get_elem_ptr.src = src;
+    inst->kind.data.get_elem_ptr.index = index;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::binary(koopa_raw_binary_op_t op, koopa_raw_value_t lhs, koopa_raw_value_t rhs)
+{
+    auto inst = newInst(int32_ty, KOOPA_RVT_BINARY);
+    inst->kind.data.binary.op = op;
+    inst->kind.data.binary.lhs = lhs;
+    inst->kind.data.binary.rhs = rhs;
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::branch(koopa_raw_value_t cond, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb)
+{
+    auto inst = newInst(unit_ty, KOOPA_RVT_BRANCH);
+    inst->kind.data.branch.cond = cond;
+    inst->kind.data.branch.true_bb = true_bb;
+    inst->kind.data.branch.false_bb = false_bb;
+    inst->kind.data.branch.true_args = slice({}, KOOPA_RSIK_VALUE);
+    inst->kind.data.branch.false_args = slice({}, KOOPA_RSIK_VALUE);
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::jump(koopa_raw_basic_block_t target)
+{
+    auto inst = newInst(unit_ty, KOOPA_RVT_JUMP);
+    inst->kind.data.jump.target = target;
+    inst->kind.data.jump.args = slice({}, KOOPA_RSIK_VALUE);
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::call(koopa_raw_function_t callee, const vector<const void *> &args)
+{
+    auto inst = newInst(callee->ty->data.function.ret, KOOPA_RVT_CALL);
+    inst->kind.data.call.callee = callee;
+    inst->kind.data.call.args = slice(args, KOOPA_RSIK_VALUE);
+    return inst;
+}
+
+koopa_raw_value_t IRBuilder::ret(koopa_raw_value_t value)
+{
+    auto inst = newInst(unit_ty, KOOPA_RVT_RETURN);
+    inst->kind.data.ret.value = value;
+    return inst;
+}
+
+koopa_raw_program_t IRBuilder::build()
+{
+    assert(!cur_func);
+    koopa_raw_program_t program;
+    program.values = slice(values, KOOPA_RSIK_VALUE);
+    program.funcs = slice(funcs, KOOPA_RSIK_FUNCTION);
+    return program;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "koopa.h"
+#include "arena.hpp"
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+
+// 在内存中直接构建 Koopa raw program, 不再经过 IR 文本和 koopa_parse_from_string;
+// 所有 raw 结构体由 builder 持有, 在 builder 析构前 raw program 一直有效;
+// 优化 pass 用到的 slice, integer, undef, newBlock, blockParam, jumpTo 可以在多个线程中同时调用,
+// 各个函数的优化因此可以并行; 其余建立 IR 的接口只在前端中使用;
+class IRBuilder
+{
+    Arena arena;
+    mutex arena_lock; // 保护 arena;
+    mutex int_lock;   // 保护 int_table, 持有时可以再获取 arena_lock;
+
+    koopa_raw_type_t int32_ty;
+    koopa_raw_type_t unit_ty;
+    unordered_map<int, koopa_raw_value_t> int_table;
+
+    vector<const void *> values; // 全局变量;
+    vector<const void *> funcs;
+    unordered_map<string, koopa_raw_function_t> func_table;
+    unordered_map<string, koopa_raw_value_t> var_table; // alloc/global alloc 的名字到 value;
+
+    koopa_raw_function_data_t *cur_func = nullptr;
+    vector<const void *> cur_params;
+    vector<const void *> cur_bbs;
+    vector<const void *> cur_allocs; // 局部变量的 alloc, endFunc 时放到入口基本块的开头;
+    koopa_raw_basic_block_data_t *cur_bb = nullptr;
+    vector<const void *> cur_insts;
+
+    template <typename T>
+    T *make()
+    {
+        lock_guard<mutex> lock(arena_lock);
+        return arena.make<T>();
+    }
+    const char *newName(const string &name);
+    koopa_raw_value_data_t *newValue(koopa_raw_type_t ty, const string &name, koopa_raw_value_tag_t tag);
+    koopa_raw_value_data_t *newInst(koopa_raw_type_t ty, koopa_raw_value_tag_t tag, const string &name = "");
+    void finishBlock();
+
+public:
+    IRBuilder();
+    // 释放所有 raw 结构体, 之前 build() 得到的 raw program 随之失效;
+    void clear();
+
+    koopa_raw_slice_t slice(const vector<const void *> &items, koopa_raw_slice_item_kind_t kind);
+
+    // 类型;
+    koopa_raw_type_t int32Type() { return int32_ty; }
+    koopa_raw_type_t unitType() { return unit_ty; }
+    koopa_raw_type_t arrayType(koopa_raw_type_t base, size_t len);
+    koopa_raw_type_t pointerType(koopa_raw_type_t base);
+
+    // 常量与初始化;
+    koopa_raw_value_t integer(int val);
+    koopa_raw_value_t zeroInit(koopa_raw_type_t ty);
+    koopa_raw_value_t aggregate(koopa_raw_type_t ty, const vector<const void *> &elems);
+    koopa_raw_value_t undef(koopa_raw_type_t ty);
+
+    // 函数与基本块;
+    koopa_raw_function_t declFunc(const string &name, const vector<koopa_raw_type_t> &params, koopa_raw_type_t ret);
+    koopa_raw_function_t beginFunc(const string &name, koopa_raw_type_t ret);
+    koopa_raw_value_t addParam(const string &name, koopa_raw_type_t ty);
+    koopa_raw_value_t getParam(size_t idx);
+    void endFunc();
+    koopa_raw_function_t getFunc(const string &name);
+    // 创建基本块, 此时还不属于任何函数;
+    koopa_raw_basic_block_t newBlock(const string &name);
+    // 把基本块接到当前函数末尾, 之后的指令都插入到这里;
+    void setBlock(koopa_raw_basic_block_t bb);
+    // 基本块参数, 由优化 pass 创建, 调用者负责把它放进基本块的 params;
+    koopa_raw_value_t blockParam(const string &name, koopa_raw_type_t ty, size_t index);
+    // 不属于任何基本块的 jump, 由优化 pass 创建, 调用者负责把它放进基本块的 insts;
+    koopa_raw_value_t jumpTo(koopa_raw_basic_block_t target, const vector<const void *> &args);
+
+    // 指令;
+    koopa_raw_value_t globalAlloc(const string &name, koopa_raw_type_t ty, koopa_raw_value_t init);
+    // 局部变量, 不论在哪个基本块中声明都分配在函数的入口基本块中;
+    koopa_raw_value_t alloc(const string &name, koopa_raw_type_t ty);
+    koopa_raw_value_t getVar(const string &name);
+    koopa_raw_value_t load(koopa_raw_value_t src);
+    koopa_raw_value_t store(koopa_raw_value_t value, koopa_raw_value_t dest);
+    koopa_raw_value_t getPtr(koopa_raw_value_t src, koopa_raw_value_t index);
+    koopa_raw_value_t getElemPtr(koopa_raw_value_t src, koopa_raw_value_t index);
+    koopa_raw_value_t binary(koopa_raw_binary_op_t op, koopa_raw_value_t lhs, koopa_raw_value_t rhs);
+    koopa_raw_value_t branch(koopa_raw_value_t cond, koopa_raw_basic_block_t true_bb, koopa_raw_basic_block_t false_bb);
+    koopa_raw_value_t jump(koopa_raw_basic_block_t target);
+    koopa_raw_value_t call(koopa_raw_function_t callee, const vector<const void *> &args);
+    koopa_raw_value_t ret(koopa_raw_value_t value);
+
+    koopa_raw_program_t build();
+};
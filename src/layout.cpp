@@ -0,0 +1,108 @@
+#include "layout.hpp"
+
+// 每个基本块所在的自然循环的层数, 回边是目标支配来源的边;
+static vector<int> _loop_depth(const CFG &cfg)
+{
+    vector<int> depth(cfg.bbs.size(), 0);
+    for (int u : cfg.rpo)
+    {
+        for (int h : cfg.succs[u])
+        {
+            if (!cfg.dominates(h, u))
+                continue;
+            // 回边 u -> h, 自然循环是 h 和不经过 h 能到达 u 的基本块;
+            vector<bool> in_loop(cfg.bbs.size(), false);
+            in_loop[h] = true;
+            vector<int> stack;
+            if (!in_loop[u])
+            {
+                in_loop[u] = true;
+                stack.push_back(u);
+            }
+            while (!stack.empty())
+            {
+                int b = stack.back();
+                stack.pop_back();
+                for (int p : cfg.preds[b])
+                {
+                    if (!in_loop[p] && cfg.reachable(p))
+                    {
+                        in_loop[p] = true;
+                        stack.push_back(p);
+                    }
+                }
+            }
+            for (size_t b = 0; b < in_loop.size(); ++b)
+                depth[b] += in_loop[b];
+        }
+    }
+    return depth;
+}
+
+// 基本块链中当前块之后应该接的后继, 没有可以接的后继时返回 -1;
+static int _next_in_chain(const CFG &cfg, int b, const vector<int> &depth, const vector<bool> &placed)
+{
+    auto bb = cfg.bbs[b];
+    auto term = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[bb->insts.len - 1]);
+    if (term->kind.tag == KOOPA_RVT_JUMP)
+    {
+        int t = cfg.bb_id.at(term->kind.data.jump.target);
+        return placed[t] ? -1 : t;
+    }
+    if (term->kind.tag != KOOPA_RVT_BRANCH)
+        return -1;
+
+    const auto &branch = term->kind.data.branch;
+    int t = cfg.bb_id.at(branch.true_bb), f = cfg.bb_id.at(branch.false_bb);
+    if (placed[t])
+        return placed[f] ? -1 : f;
+    if (placed[f])
+        return t;
+    // 留在循环内的一侧顺序执行, 同样深时接真分支 (then 块, 循环体);
+    return depth[f] > depth[t] ? f : t;
+}
+
+static int _layout_func(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    vector<int> depth = _loop_depth(cfg);
+    size_t n = cfg.bbs.size();
+    vector<bool> placed(n, false);
+    vector<int> order;
+
+    for (size_t seed = 0; seed < n; ++seed)
+    {
+        for (int b = placed[seed] ? -1 : seed; b >= 0; b = _next_in_chain(cfg, b, depth, placed))
+        {
+            placed[b] = true;
+            order.push_back(b);
+        }
+    }
+
+    int fallthrough = 0;
+    vector<const void *> bbs;
+    for (size_t i = 0; i < n; ++i)
+    {
+        bbs.push_back(cfg.bbs[order[i]]);
+        if (i + 1 < n)
+        {
+            for (int s : cfg.succs[order[i]])
+            {
+                if (s == order[i + 1])
+                {
+                    fallthrough++;
+                    break;
+                }
+            }
+        }
+    }
+    const_cast<koopa_raw_function_data_t *>(func)->bbs = ir_builder.slice(bbs, KOOPA_RSIK_BASIC_BLOCK);
+    return fallthrough;
+}
+
+PassStats layoutBlocks(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    PassStats stats("layout", func);
+    stats.add("fallthrough", _layout_func(func, ir_builder));
+    return stats;
+}
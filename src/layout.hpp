@@ -0,0 +1,14 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 基本块排布, -O1 时在 dce 之后作为最后一个 pass 运行; 之后的 pass 会改变基本块和跳转, 破坏排布结果;
+// 从入口开始贪心地把基本块连成链: jump 的目标紧跟在后面, branch 优先接循环嵌套更深的一侧,
+// 使循环体留在循环内的一侧顺序执行, 离开循环的一侧成为 (通常不跳转的) 条件分支;
+// 链断开时从原来顺序中第一个未排布的基本块开始新的链, 入口仍然是第一个基本块;
+// 代码生成时跳到下一个基本块的 jump 被省略, branch 在需要时反转条件;
+// 统计目标紧跟在后面的跳转边数 (fallthrough);
+PassStats layoutBlocks(const koopa_raw_function_t &func, IRBuilder &ir_builder);
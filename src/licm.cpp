@@ -0,0 +1,364 @@
+#include "licm.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+static koopa_raw_value_t _slice_value(const koopa_raw_slice_t &slice, size_t i)
+{
+    return reinterpret_cast<koopa_raw_value_t>(slice.buffer[i]);
+}
+
+static koopa_raw_value_t _term(const koopa_raw_basic_block_t &bb)
+{
+    return _slice_value(bb->insts, bb->insts.len - 1);
+}
+
+static bool _is_addr(const koopa_raw_value_t &v)
+{
+    return v->kind.tag == KOOPA_RVT_GET_ELEM_PTR || v->kind.tag == KOOPA_RVT_GET_PTR;
+}
+
+static koopa_raw_value_t _addr_src(const koopa_raw_value_t &v)
+{
+    return v->kind.tag == KOOPA_RVT_GET_ELEM_PTR ? v->kind.data.get_elem_ptr.src : v->kind.data.get_ptr.src;
+}
+
+static koopa_raw_value_t _addr_index(const koopa_raw_value_t &v)
+{
+    return v->kind.tag == KOOPA_RVT_GET_ELEM_PTR ? v->kind.data.get_elem_ptr.index : v->kind.data.get_ptr.index;
+}
+
+// 地址的来源: 全局变量, 局部数组, 或者不知道指向哪里的指针 (数组参数);
+// path 是从来源出发依次经过的 getelemptr/getptr;
+static koopa_raw_value_t _addr_root(koopa_raw_value_t v, vector<koopa_raw_value_t> &path)
+{
+    path.clear();
+    for (; _is_addr(v); v = _addr_src(v))
+        path.push_back(v);
+    reverse(path.begin(), path.end());
+    return v;
+}
+
+static bool _is_object(const koopa_raw_value_t &root)
+{
+    return root->kind.tag == KOOPA_RVT_ALLOC || root->kind.tag == KOOPA_RVT_GLOBAL_ALLOC;
+}
+
+// 两个地址是否可能指向同一个位置;
+// 不同的全局变量和局部数组互不重叠, 数组参数只可能指向调用者的数组或全局变量;
+// 来源相同时, 同一层的下标是不同的常量则不重叠;
+static bool _may_alias(const koopa_raw_value_t &a, const koopa_raw_value_t &b)
+{
+    vector<koopa_raw_value_t> pa, pb;
+    auto ra = _addr_root(a, pa), rb = _addr_root(b, pb);
+    if (ra != rb)
+    {
+        if (_is_object(ra) && _is_object(rb))
+            return false;
+        return ra->kind.tag != KOOPA_RVT_ALLOC && rb->kind.tag != KOOPA_RVT_ALLOC;
+    }
+    for (size_t i = 0; i < pa.size() && i < pb.size(); ++i)
+    {
+        if (pa[i]->kind.tag != pb[i]->kind.tag)
+            break;
+        auto ia = _addr_index(pa[i]), ib = _addr_index(pb[i]);
+        if (ia->kind.tag == KOOPA_RVT_INTEGER && ib->kind.tag == KOOPA_RVT_INTEGER &&
+            ia->kind.data.integer.value != ib->kind.data.integer.value)
+            return false;
+    }
+    return true;
+}
+
+// 自然循环: 循环头和循环中的基本块, 按逆后序排列;
+struct Loop
+{
+    int header;
+    vector<int> blocks;
+    vector<int> latches;
+};
+
+static vector<Loop> _find_loops(const CFG &cfg)
+{
+    vector<Loop> loops;
+    unordered_map<int, size_t> loop_of;
+    for (auto t : cfg.rpo)
+    {
+        for (auto h : cfg.succs[t])
+        {
+            if (!cfg.dominates(h, t))
+                continue;
+            if (!loop_of.count(h))
+            {
+                loop_of[h] = loops.size();
+                loops.push_back({h, {}, {}});
+            }
+            loops[loop_of[h]].latches.push_back(t);
+        }
+    }
+
+    // 从回边的来源逆着控制流走到循环头;
+    for (auto &loop : loops)
+    {
+        vector<bool> in(cfg.bbs.size(), false);
+        in[loop.header] = true;
+        vector<int> stack;
+        for (auto t : loop.latches)
+        {
+            if (!in[t])
+            {
+                in[t] = true;
+                stack.push_back(t);
+            }
+        }
+        while (!stack.empty())
+        {
+            int b = stack.back();
+            stack.pop_back();
+            for (auto p : cfg.preds[b])
+            {
+                if (!in[p] && cfg.reachable(p))
+                {
+                    in[p] = true;
+                    stack.push_back(p);
+                }
+            }
+        }
+        for (auto b : cfg.rpo)
+        {
+            if (in[b])
+                loop.blocks.push_back(b);
+        }
+    }
+
+    // 内层循环先处理, 外提到内层前置基本块的指令还有机会继续外提;
+    stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b)
+                { return a.blocks.size() < b.blocks.size(); });
+    return loops;
+}
+
+// 给需要的循环头插入前置基本块, 返回插入的个数;
+// 循环头唯一的外部前驱只有这一个后继时, 它本身就是前置基本块;
+static int _insert_preheaders(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    auto loops = _find_loops(cfg);
+    vector<const void *> bbs(func->bbs.buffer, func->bbs.buffer + func->bbs.len);
+    int inserted = 0;
+    for (auto &loop : loops)
+    {
+        if (loop.header == 0)
+            continue;
+        unordered_set<int> in(loop.blocks.begin(), loop.blocks.end());
+        vector<int> outside;
+        for (auto p : cfg.preds[loop.header])
+        {
+            if (!in.count(p) && cfg.reachable(p))
+                outside.push_back(p);
+        }
+        if (outside.size() == 1 && cfg.succs[outside[0]].size() == 1)
+            continue;
+
+        // 只有一条外部入边时实参直接写在前置基本块的 jump 上, 否则前置基本块接收和循环头相同的参数;
+        auto header = cfg.bbs[loop.header];
+        auto pre = ir_builder.newBlock(string(header->name) + "_pre");
+        vector<const void *> params, args;
+        bool single = outside.size() == 1;
+        if (!single)
+        {
+            for (size_t k = 0; k < header->params.len; ++k)
+            {
+                auto param = _slice_value(header->params, k);
+                params.push_back(ir_builder.blockParam(string(param->name) + "_pre", param->ty, k));
+            }
+            const_cast<koopa_raw_basic_block_data_t *>(pre)->params = ir_builder.slice(params, KOOPA_RSIK_VALUE);
+            args = params;
+        }
+
+        for (auto p : outside)
+        {
+            auto &kind = const_cast<koopa_raw_value_data_t *>(_term(cfg.bbs[p]))->kind;
+            auto retarget = [&](koopa_raw_basic_block_t &target, koopa_raw_slice_t &target_args)
+            {
+                if (target != header)
+                    return;
+                if (single)
+                {
+                    args.assign(target_args.buffer, target_args.buffer + target_args.len);
+                    target_args = ir_builder.slice({}, KOOPA_RSIK_VALUE);
+                }
+                target = pre;
+            };
+            if (kind.tag == KOOPA_RVT_JUMP)
+                retarget(kind.data.jump.target, kind.data.jump.args);
+            else if (kind.tag == KOOPA_RVT_BRANCH)
+            {
+                retarget(kind.data.branch.true_bb, kind.data.branch.true_args);
+                retarget(kind.data.branch.false_bb, kind.data.branch.false_args);
+            }
+        }
+        vector<const void *> insts{ir_builder.jumpTo(header, args)};
+        const_cast<koopa_raw_basic_block_data_t *>(pre)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+
+        bbs.insert(find(bbs.begin(), bbs.end(), (const void *)header), pre);
+        inserted++;
+    }
+    if (inserted)
+        const_cast<koopa_raw_function_data_t *>(func)->bbs = ir_builder.slice(bbs, KOOPA_RSIK_BASIC_BLOCK);
+    return inserted;
+}
+
+// 外提一个函数中的循环不变量, 返回外提的指令数;
+static int _hoist(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    auto loops = _find_loops(cfg);
+    if (loops.empty())
+        return 0;
+
+    // 每条指令和基本块参数所在的基本块, 外提后随之更新;
+    unordered_map<koopa_raw_value_t, int> def_bb;
+    for (size_t b = 0; b < cfg.bbs.size(); ++b)
+    {
+        auto bb = cfg.bbs[b];
+        for (size_t k = 0; k < bb->params.len; ++k)
+            def_bb[_slice_value(bb->params, k)] = b;
+        for (size_t i = 0; i < bb->insts.len; ++i)
+            def_bb[_slice_value(bb->insts, i)] = b;
+    }
+
+    // 地址被当作值使用 (传给函数或存入内存) 的局部数组, 函数调用可能修改它们;
+    unordered_set<koopa_raw_value_t> escaped;
+    vector<koopa_raw_value_t> path;
+    for (auto bb : cfg.bbs)
+    {
+        for (size_t i = 0; i < bb->insts.len; ++i)
+        {
+            auto inst = _slice_value(bb->insts, i);
+            if (inst->kind.tag == KOOPA_RVT_CALL)
+            {
+                for (size_t k = 0; k < inst->kind.data.call.args.len; ++k)
+                    escaped.insert(_addr_root(_slice_value(inst->kind.data.call.args, k), path));
+            }
+            else if (inst->kind.tag == KOOPA_RVT_STORE)
+                escaped.insert(_addr_root(inst->kind.data.store.value, path));
+        }
+    }
+
+    int hoisted = 0;
+    vector<koopa_raw_value_t> ops;
+    for (auto &loop : loops)
+    {
+        if (loop.header == 0)
+            continue;
+        unordered_set<int> in(loop.blocks.begin(), loop.blocks.end());
+
+        // 前置基本块: 循环头唯一的外部前驱;
+        int pre = -1;
+        for (auto p : cfg.preds[loop.header])
+        {
+            if (!in.count(p) && cfg.reachable(p))
+                pre = p;
+        }
+        assert(pre >= 0 && cfg.succs[pre].size() == 1);
+
+        // 循环中的 store 地址和 call, 以及 load 可以外提时所在基本块必须支配的出口;
+        vector<koopa_raw_value_t> stores;
+        bool has_call = false;
+        vector<int> exits;
+        for (auto b : loop.blocks)
+        {
+            auto bb = cfg.bbs[b];
+            for (size_t i = 0; i < bb->insts.len; ++i)
+            {
+                auto inst = _slice_value(bb->insts, i);
+                if (inst->kind.tag == KOOPA_RVT_STORE)
+                    stores.push_back(inst->kind.data.store.dest);
+                else if (inst->kind.tag == KOOPA_RVT_CALL)
+                    has_call = true;
+            }
+            for (auto s : cfg.succs[b])
+            {
+                if (!in.count(s))
+                {
+                    exits.push_back(b);
+                    break;
+                }
+            }
+        }
+
+        auto invariant = [&](koopa_raw_value_t v)
+        {
+            auto it = def_bb.find(v);
+            return it == def_bb.end() || !in.count(it->second);
+        };
+        auto load_invariant = [&](int b, koopa_raw_value_t src)
+        {
+            for (auto e : exits)
+            {
+                if (!cfg.dominates(b, e))
+                    return false;
+            }
+            for (auto dest : stores)
+            {
+                if (_may_alias(src, dest))
+                    return false;
+            }
+            if (has_call)
+            {
+                auto root = _addr_root(src, path);
+                if (root->kind.tag != KOOPA_RVT_ALLOC || escaped.count(root))
+                    return false;
+            }
+            return true;
+        };
+
+        // 按逆后序扫描, 不变量的操作数先于它被外提;
+        vector<const void *> moved;
+        for (auto b : loop.blocks)
+        {
+            auto bb = cfg.bbs[b];
+            vector<const void *> insts;
+            for (size_t i = 0; i < bb->insts.len; ++i)
+            {
+                auto inst = _slice_value(bb->insts, i);
+                auto tag = inst->kind.tag;
+                bool hoist = false;
+                if (tag == KOOPA_RVT_BINARY || tag == KOOPA_RVT_GET_ELEM_PTR || tag == KOOPA_RVT_GET_PTR)
+                {
+                    getOperands(inst, ops);
+                    hoist = all_of(ops.begin(), ops.end(), invariant);
+                }
+                else if (tag == KOOPA_RVT_LOAD)
+                    hoist = invariant(inst->kind.data.load.src) && load_invariant(b, inst->kind.data.load.src);
+                if (hoist)
+                {
+                    moved.push_back(inst);
+                    def_bb[inst] = pre;
+                    continue;
+                }
+                insts.push_back(inst);
+            }
+            if (insts.size() != bb->insts.len)
+                const_cast<koopa_raw_basic_block_data_t *>(bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+        }
+        if (moved.empty())
+            continue;
+
+        auto pre_bb = cfg.bbs[pre];
+        vector<const void *> insts(pre_bb->insts.buffer, pre_bb->insts.buffer + pre_bb->insts.len - 1);
+        insts.insert(insts.end(), moved.begin(), moved.end());
+        insts.push_back(_term(pre_bb));
+        const_cast<koopa_raw_basic_block_data_t *>(pre_bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+        hoisted += moved.size();
+    }
+    return hoisted;
+}
+
+PassStats licm(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    PassStats stats("licm", func);
+    int preheaders = _insert_preheaders(func, ir_builder);
+    stats.add("hoisted", _hoist(func, ir_builder));
+    stats.add("preheaders", preheaders);
+    return stats;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 循环不变量外提, -O1 时在 gvn 之后运行;
+// 由回边 (目标支配来源的边) 求自然循环, 循环头有多个外部前驱或前驱还有其他后继时插入前置基本块;
+// 从内层循环到外层循环, 把操作数都在循环外定义的纯计算 (binary, getelemptr, getptr) 移到前置基本块,
+// load 的地址不变, 所在基本块支配循环的所有出口, 并且循环中的 store 和 call 都不可能修改它时同样外提;
+// 统计外提的指令数 (hoisted) 和插入的前置基本块数 (preheaders);
+PassStats licm(const koopa_raw_function_t &func, IRBuilder &ir_builder);
@@ -0,0 +1,259 @@
+#include "mem2reg.hpp"
+
+static koopa_raw_value_t _inst(const koopa_raw_basic_block_t &bb, size_t i)
+{
+    return reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[i]);
+}
+
+// 删除入口不可达的基本块, 它们不参与支配树, 也不会被重命名, 返回删除的基本块数;
+static int _remove_unreachable(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    if (cfg.rpo.size() == cfg.bbs.size())
+        return 0;
+    vector<const void *> bbs;
+    for (size_t i = 0; i < cfg.bbs.size(); ++i)
+        if (cfg.reachable(i))
+            bbs.push_back(cfg.bbs[i]);
+    const_cast<koopa_raw_function_data_t *>(func)->bbs = ir_builder.slice(bbs, KOOPA_RSIK_BASIC_BLOCK);
+    return cfg.bbs.size() - bbs.size();
+}
+
+// 返回提升的 alloc 数;
+static int _promote(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    size_t bb_num = cfg.bbs.size();
+
+    // 候选: 分配 i32 或指针的 alloc, 数组要按地址访问, 不能提升;
+    unordered_map<koopa_raw_value_t, int> alloc_id;
+    vector<koopa_raw_value_t> allocs;
+    for (auto bb : cfg.bbs)
+    {
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = _inst(bb, j);
+            if (inst->kind.tag != KOOPA_RVT_ALLOC)
+                continue;
+            auto base = inst->ty->data.pointer.base->tag;
+            if (base == KOOPA_RTT_INT32 || base == KOOPA_RTT_POINTER)
+            {
+                alloc_id[inst] = allocs.size();
+                allocs.push_back(inst);
+            }
+        }
+    }
+
+    // 地址只能作为 load 的 src 或 store 的 dest 出现, 否则地址逃逸;
+    vector<bool> promotable(allocs.size(), true);
+    vector<koopa_raw_value_t> ops;
+    for (auto bb : cfg.bbs)
+    {
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = _inst(bb, j);
+            if (inst->kind.tag == KOOPA_RVT_LOAD)
+                continue;
+            if (inst->kind.tag == KOOPA_RVT_STORE)
+                ops.assign(1, inst->kind.data.store.value);
+            else
+                getOperands(inst, ops);
+            for (auto op : ops)
+            {
+                auto it = alloc_id.find(op);
+                if (it != alloc_id.end())
+                    promotable[it->second] = false;
+            }
+        }
+    }
+    alloc_id.clear();
+    {
+        vector<koopa_raw_value_t> kept;
+        for (size_t a = 0; a < allocs.size(); ++a)
+        {
+            if (!promotable[a])
+                continue;
+            alloc_id[allocs[a]] = kept.size();
+            kept.push_back(allocs[a]);
+        }
+        allocs.swap(kept);
+    }
+    size_t n = allocs.size();
+    if (!n)
+        return 0;
+    auto promoted = [&](koopa_raw_value_t ptr)
+    {
+        auto it = alloc_id.find(ptr);
+        return it == alloc_id.end() ? -1 : it->second;
+    };
+
+    // 每个基本块中向上暴露的 load 和 store, 以及各个 alloc 的活跃性;
+    vector<BitSet> use(bb_num, BitSet(n)), def(bb_num, BitSet(n));
+    vector<BitSet> live_in(bb_num, BitSet(n));
+    vector<vector<int>> def_blocks(n);
+    for (size_t i = 0; i < bb_num; ++i)
+    {
+        auto bb = cfg.bbs[i];
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = _inst(bb, j);
+            int a;
+            if (inst->kind.tag == KOOPA_RVT_LOAD && (a = promoted(inst->kind.data.load.src)) >= 0)
+            {
+                if (!def[i].test(a))
+                    use[i].set(a);
+            }
+            else if (inst->kind.tag == KOOPA_RVT_STORE && (a = promoted(inst->kind.data.store.dest)) >= 0)
+            {
+                if (!def[i].test(a))
+                {
+                    def[i].set(a);
+                    def_blocks[a].push_back(i);
+                }
+            }
+        }
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t k = cfg.rpo.size(); k-- > 0;)
+        {
+            int i = cfg.rpo[k];
+            BitSet out(n);
+            for (auto s : cfg.succs[i])
+                out.unite(live_in[s]);
+            changed |= live_in[i].assignLiveIn(use[i], out, def[i]);
+        }
+    }
+
+    // 在迭代支配边界上放置参数, 只在 alloc 活跃的汇合点放置;
+    vector<vector<int>> param_allocs(bb_num);
+    vector<int> placed(bb_num, -1);
+    for (size_t a = 0; a < n; ++a)
+    {
+        vector<int> worklist = def_blocks[a];
+        while (!worklist.empty())
+        {
+            int b = worklist.back();
+            worklist.pop_back();
+            for (auto d : cfg.df[b])
+            {
+                if (placed[d] == (int)a || !live_in[d].test(a))
+                    continue;
+                placed[d] = a;
+                param_allocs[d].push_back(a);
+                worklist.push_back(d);
+            }
+        }
+    }
+
+    vector<vector<koopa_raw_value_t>> params(bb_num);
+    for (size_t b = 0; b < bb_num; ++b)
+    {
+        if (param_allocs[b].empty())
+            continue;
+        vector<const void *> items;
+        for (size_t k = 0; k < param_allocs[b].size(); ++k)
+        {
+            auto alloc = allocs[param_allocs[b][k]];
+            string name = "%" + string(alloc->name ? alloc->name + 1 : "p") + "_" + to_string(b);
+            auto param = ir_builder.blockParam(name, alloc->ty->data.pointer.base, k);
+            params[b].push_back(param);
+            items.push_back(param);
+        }
+        const_cast<koopa_raw_basic_block_data_t *>(cfg.bbs[b])->params = ir_builder.slice(items, KOOPA_RSIK_VALUE);
+    }
+
+    // 沿支配树重命名, cur[a] 是 alloc a 的当前值栈, 没有定值时读到 undef;
+    vector<vector<koopa_raw_value_t>> cur(n);
+    vector<koopa_raw_value_t> undefs(n, nullptr);
+    unordered_map<koopa_raw_value_t, koopa_raw_value_t> replace;
+    auto top = [&](int a)
+    {
+        if (!cur[a].empty())
+            return cur[a].back();
+        if (!undefs[a])
+            undefs[a] = ir_builder.undef(allocs[a]->ty->data.pointer.base);
+        return undefs[a];
+    };
+    auto resolve = [&](koopa_raw_value_t v)
+    {
+        auto it = replace.find(v);
+        return it == replace.end() ? v : it->second;
+    };
+    auto argsFor = [&](koopa_raw_basic_block_t target)
+    {
+        vector<const void *> args;
+        for (auto a : param_allocs[cfg.bb_id[target]])
+            args.push_back(top(a));
+        return ir_builder.slice(args, KOOPA_RSIK_VALUE);
+    };
+
+    // 显式栈代替递归, second 为真表示离开该基本块的子树;
+    vector<vector<int>> pushed(bb_num);
+    vector<pair<int, bool>> stack{{0, false}};
+    while (!stack.empty())
+    {
+        auto [b, leave] = stack.back();
+        stack.pop_back();
+        if (leave)
+        {
+            for (auto a : pushed[b])
+                cur[a].pop_back();
+            continue;
+        }
+        stack.emplace_back(b, true);
+
+        for (size_t k = 0; k < params[b].size(); ++k)
+        {
+            cur[param_allocs[b][k]].push_back(params[b][k]);
+            pushed[b].push_back(param_allocs[b][k]);
+        }
+
+        auto bb = cfg.bbs[b];
+        vector<const void *> insts;
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = _inst(bb, j);
+            auto &kind = const_cast<koopa_raw_value_data_t *>(inst)->kind;
+            int a;
+            if (kind.tag == KOOPA_RVT_ALLOC && promoted(inst) >= 0)
+                continue;
+            if (kind.tag == KOOPA_RVT_LOAD && (a = promoted(kind.data.load.src)) >= 0)
+            {
+                replace[inst] = top(a);
+                continue;
+            }
+            if (kind.tag == KOOPA_RVT_STORE && (a = promoted(kind.data.store.dest)) >= 0)
+            {
+                cur[a].push_back(resolve(kind.data.store.value));
+                pushed[b].push_back(a);
+                continue;
+            }
+            replaceOperands(inst, resolve);
+            if (kind.tag == KOOPA_RVT_JUMP)
+                kind.data.jump.args = argsFor(kind.data.jump.target);
+            else if (kind.tag == KOOPA_RVT_BRANCH)
+            {
+                kind.data.branch.true_args = argsFor(kind.data.branch.true_bb);
+                kind.data.branch.false_args = argsFor(kind.data.branch.false_bb);
+            }
+            insts.push_back(inst);
+        }
+        const_cast<koopa_raw_basic_block_data_t *>(bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+
+        for (auto it = cfg.dom_children[b].rbegin(); it != cfg.dom_children[b].rend(); ++it)
+            stack.emplace_back(*it, false);
+    }
+
+    return n;
+}
+
+PassStats mem2reg(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    PassStats stats("mem2reg", func);
+    stats.add("unreachable", _remove_unreachable(func, ir_builder));
+    stats.add("promoted", _promote(func, ir_builder));
+    return stats;
+}
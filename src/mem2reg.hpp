@@ -0,0 +1,13 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 把只被 load/store 直接访问的标量 alloc 提升为 SSA 值, -O1 时启用;
+// 在支配边界上按活跃性放置基本块参数 (pruned SSA), 再沿支配树重命名,
+// 汇合点的值通过 jump/branch 的参数传入, 原来的 alloc/load/store 被删除;
+// 不可达的基本块会先被删除;
+// 统计删除的不可达基本块数 (unreachable) 和提升的 alloc 数 (promoted);
+PassStats mem2reg(const koopa_raw_function_t &func, IRBuilder &ir_builder);
@@ -0,0 +1,71 @@
+#include "output.hpp"
+#include <cassert>
+#include <cerrno>
+#include <string.h>
+#include <unistd.h>
+
+void OutputWriter::open(int _fd)
+{
+    fd = _fd;
+    sink = nullptr;
+    buf.resize(BUF_SIZE);
+    len = total = 0;
+    failed = false;
+}
+
+void OutputWriter::open(string *_sink)
+{
+    fd = -1;
+    sink = _sink;
+    buf.resize(BUF_SIZE);
+    len = total = 0;
+    failed = false;
+}
+
+void OutputWriter::writeAll(const char *data, size_t size)
+{
+    if (sink)
+    {
+        sink->append(data, size);
+        return;
+    }
+    assert(fd >= 0);
+    while (size && !failed)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            failed = true;
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void OutputWriter::write(const char *data, size_t size)
+{
+    if (failed)
+        return;
+    total += size;
+    if (len + size > BUF_SIZE)
+    {
+        flush();
+        // 比缓冲区还大的块不再复制, 直接写出;
+        if (size >= BUF_SIZE)
+        {
+            writeAll(data, size);
+            return;
+        }
+    }
+    memcpy(buf.data() + len, data, size);
+    len += size;
+}
+
+void OutputWriter::flush()
+{
+    writeAll(buf.data(), len);
+    len = 0;
+}
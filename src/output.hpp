@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 带固定大小缓冲区的输出, 缓冲区写满时直接写到文件描述符, 或追加到调用者的 string 中;
+// 代码生成每完成一个函数或全局变量就把 riscv_ret_str 交给它, 内存占用与整个输出的大小无关;
+// write 出错 (磁盘满, 管道关闭等) 后丢弃之后的所有输出, 由调用者通过 ok() 检查;
+class OutputWriter
+{
+    static const size_t BUF_SIZE = 64 * 1024;
+
+    int fd = -1;
+    string *sink = nullptr;
+    vector<char> buf;
+    size_t len = 0;
+    size_t total = 0;
+    bool failed = false; // 写文件描述符出错后不再写出;
+
+    void writeAll(const char *data, size_t size);
+
+public:
+    // 输出到文件描述符;
+    void open(int _fd);
+    // 输出到内存, 用于库接口 compile();
+    void open(string *_sink);
+
+    void write(const char *data, size_t size);
+    void write(const string &s) { write(s.data(), s.size()); }
+    void flush();
+
+    size_t bytesWritten() { return total; }
+    // 到目前为止的写出都成功;
+    bool ok() { return !failed; }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "koopa.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// 优化 pass 在一个函数上的统计: 每个 pass 对一个函数运行一次, 返回一个 PassStats;
+// pass 本身不输出, 由调用者决定是否打印 (命令行的 -stats);
+struct PassStats
+{
+    const char *pass;
+    string func;
+    vector<pair<const char *, int>> counts; // (计数的名字, 值), 按 pass 添加的顺序;
+
+    PassStats(const char *_pass, const koopa_raw_function_t &_func) : pass(_pass), func(_func->name) {}
+    void add(const char *name, int n) { counts.emplace_back(name, n); }
+};
+
+// 输出一行统计, 如 "//! dce @f: insts 3, blocks 1, params 0";
+inline ostream &operator<<(ostream &os, const PassStats &stats)
+{
+    os << "//! " << stats.pass << " " << stats.func << ":";
+    const char *sep = " ";
+    for (auto &count : stats.counts)
+    {
+        os << sep << count.first << " " << count.second;
+        sep = ", ";
+    }
+    return os;
+}
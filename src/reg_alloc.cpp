@@ -0,0 +1,398 @@
+#include "reg_alloc.hpp"
+#include "simplify.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+// 可分配的寄存器, 前 CALLER_SAVED_NUM 个是调用者保存的;
+static const char *alloc_regs[] = {"t3", "t4", "t5",
+                                   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11"};
+static const int CALLER_SAVED_NUM = 3;
+static const int REG_NUM = sizeof(alloc_regs) / sizeof(alloc_regs[0]);
+
+bool needLocation(const koopa_raw_value_t &value)
+{
+    switch (value->kind.tag)
+    {
+    case KOOPA_RVT_LOAD:
+    case KOOPA_RVT_BINARY:
+    case KOOPA_RVT_GET_ELEM_PTR:
+    case KOOPA_RVT_GET_PTR:
+        return true;
+    case KOOPA_RVT_CALL:
+        return value->ty->tag != KOOPA_RTT_UNIT;
+    default:
+        return false;
+    }
+}
+
+static bool _is_addr(const koopa_raw_value_t &value)
+{
+    return value->kind.tag == KOOPA_RVT_GET_ELEM_PTR || value->kind.tag == KOOPA_RVT_GET_PTR;
+}
+
+static koopa_raw_value_t _addr_src(const koopa_raw_value_t &value)
+{
+    if (value->kind.tag == KOOPA_RVT_GET_ELEM_PTR)
+        return value->kind.data.get_elem_ptr.src;
+    return value->kind.data.get_ptr.src;
+}
+
+static koopa_raw_value_t _addr_index(const koopa_raw_value_t &value)
+{
+    if (value->kind.tag == KOOPA_RVT_GET_ELEM_PTR)
+        return value->kind.data.get_elem_ptr.index;
+    return value->kind.data.get_ptr.index;
+}
+
+void findFoldedAddrs(const koopa_raw_function_t &func, unordered_set<koopa_raw_value_t> &folded)
+{
+    folded.clear();
+    unordered_map<koopa_raw_value_t, int> users;
+    unordered_map<koopa_raw_value_t, koopa_raw_basic_block_t> def_bb, user_bb;
+    unordered_set<koopa_raw_value_t> escaped;
+    vector<koopa_raw_value_t> ops;
+    for (size_t i = 0; i < func->bbs.len; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            if (_is_addr(inst))
+                def_bb[inst] = bb;
+            getOperands(inst, ops);
+            for (size_t k = 0; k < ops.size(); ++k)
+            {
+                if (!_is_addr(ops[k]))
+                    continue;
+                // load 的 src, store 的 dest 和 getelemptr/getptr 的 src;
+                bool addr_use = inst->kind.tag == KOOPA_RVT_LOAD ||
+                                (inst->kind.tag == KOOPA_RVT_STORE && k == 1) ||
+                                (_is_addr(inst) && k == 0);
+                if (!addr_use)
+                    escaped.insert(ops[k]);
+                users[ops[k]]++;
+                user_bb[ops[k]] = bb;
+            }
+        }
+    }
+
+    for (auto &def : def_bb)
+    {
+        auto value = def.first;
+        if (escaped.count(value))
+            continue;
+        bool const_chain = true;
+        for (auto v = value; _is_addr(v) && const_chain; v = _addr_src(v))
+            const_chain = _addr_index(v)->kind.tag == KOOPA_RVT_INTEGER;
+        if (!users.count(value) || const_chain || (users[value] == 1 && user_bb[value] == def.second))
+            folded.insert(value);
+    }
+}
+
+void findFusedCompares(const koopa_raw_function_t &func, unordered_set<koopa_raw_value_t> &fused)
+{
+    fused.clear();
+    unordered_map<koopa_raw_value_t, int> users;
+    vector<koopa_raw_value_t> ops;
+    for (size_t i = 0; i < func->bbs.len; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            getOperands(reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]), ops);
+            for (auto op : ops)
+                users[op]++;
+        }
+    }
+
+    for (size_t i = 0; i < func->bbs.len; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        auto term = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[bb->insts.len - 1]);
+        if (term->kind.tag != KOOPA_RVT_BRANCH)
+            continue;
+        auto cond = term->kind.data.branch.cond;
+        if (cond->kind.tag != KOOPA_RVT_BINARY || !isCompareOp(cond->kind.data.binary.op) || users[cond] != 1)
+            continue;
+        for (size_t j = 0; j + 1 < bb->insts.len; ++j)
+        {
+            if (bb->insts.buffer[j] == cond)
+            {
+                fused.insert(cond);
+                break;
+            }
+        }
+    }
+}
+
+// 折叠的地址在使用者处计算, 把它们替换为自己的基址和下标; 合并进 branch 的比较替换为两个操作数;
+static void _expand_folded(vector<koopa_raw_value_t> &ops, const unordered_set<koopa_raw_value_t> &folded,
+                           const unordered_set<koopa_raw_value_t> &fused)
+{
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        if (fused.count(ops[i]))
+        {
+            ops.push_back(ops[i]->kind.data.binary.rhs);
+            ops[i] = ops[i]->kind.data.binary.lhs;
+        }
+        while (folded.count(ops[i]))
+        {
+            ops.push_back(_addr_index(ops[i]));
+            ops[i] = _addr_src(ops[i]);
+        }
+    }
+}
+
+struct LiveInterval
+{
+    koopa_raw_value_t value;
+    int start = INT_MAX;
+    int end = -1;
+    bool cross_call = false;
+    int reg = -1;
+};
+
+void RegAlloc::clear()
+{
+    reg_table.clear();
+    used_callee_saved.clear();
+}
+
+void RegAlloc::run(const koopa_raw_function_t &func, const unordered_set<koopa_raw_value_t> &folded,
+                   const unordered_set<koopa_raw_value_t> &fused)
+{
+    clear();
+
+    // 指令按基本块顺序编号, 第 k 条指令在 2k 处读操作数, 在 2k+1 处写结果;
+    size_t bb_num = func->bbs.len;
+    unordered_map<koopa_raw_basic_block_t, int> bb_id;
+    unordered_map<koopa_raw_value_t, int> value_id;
+    vector<LiveInterval> intervals;
+    vector<int> bb_start(bb_num), bb_end(bb_num);
+    vector<int> call_pos;
+    auto addInterval = [&](koopa_raw_value_t value)
+    {
+        value_id[value] = intervals.size();
+        intervals.emplace_back();
+        intervals.back().value = value;
+    };
+    // 函数参数在 -1 处定值, 基本块参数在基本块开头定值;
+    for (size_t i = 0; i < func->params.len; ++i)
+        addInterval(reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]));
+    int pos = 0;
+    for (size_t i = 0; i < bb_num; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        bb_id[bb] = i;
+        bb_start[i] = pos;
+        for (size_t j = 0; j < bb->params.len; ++j)
+            addInterval(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j]));
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            if (needLocation(inst) && !folded.count(inst) && !fused.count(inst))
+                addInterval(inst);
+            if (inst->kind.tag == KOOPA_RVT_CALL)
+                call_pos.push_back(pos);
+            pos += 2;
+        }
+        bb_end[i] = pos - 1;
+    }
+    size_t n = intervals.size();
+    if (!n)
+        return;
+
+    // 每个基本块的 use/def 集合;
+    vector<BitSet> use(bb_num, BitSet(n)), def(bb_num, BitSet(n));
+    vector<BitSet> live_in(bb_num, BitSet(n)), live_out(bb_num, BitSet(n));
+    vector<vector<int>> succ(bb_num);
+    vector<koopa_raw_value_t> ops;
+    vector<koopa_raw_basic_block_t> succs;
+    for (size_t i = 0; i < bb_num; ++i)
+    {
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        if (i == 0)
+        {
+            for (size_t j = 0; j < func->params.len; ++j)
+                def[i].set(value_id[reinterpret_cast<koopa_raw_value_t>(func->params.buffer[j])]);
+        }
+        for (size_t j = 0; j < bb->params.len; ++j)
+            def[i].set(value_id[reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j])]);
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            getOperands(inst, ops);
+            _expand_folded(ops, folded, fused);
+            for (auto op : ops)
+            {
+                auto it = value_id.find(op);
+                if (it != value_id.end() && !def[i].test(it->second))
+                    use[i].set(it->second);
+            }
+            auto it = value_id.find(inst);
+            if (it != value_id.end())
+                def[i].set(it->second);
+        }
+        getSuccessors(bb, succs);
+        for (auto s : succs)
+            succ[i].push_back(bb_id[s]);
+    }
+
+    // 逆序迭代到不动点;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = bb_num; i-- > 0;)
+        {
+            BitSet out(n);
+            for (auto s : succ[i])
+                out.unite(live_in[s]);
+            live_out[i] = out;
+            changed |= live_in[i].assignLiveIn(use[i], out, def[i]);
+        }
+    }
+
+    // 活跃区间取所有活跃位置的最小值到最大值, 不考虑区间中的空洞;
+    auto extend = [&](int id, int p)
+    {
+        intervals[id].start = min(intervals[id].start, p);
+        intervals[id].end = max(intervals[id].end, p);
+    };
+    for (size_t j = 0; j < func->params.len; ++j)
+        extend(value_id[reinterpret_cast<koopa_raw_value_t>(func->params.buffer[j])], -1);
+    pos = 0;
+    for (size_t i = 0; i < bb_num; ++i)
+    {
+        for (size_t id = 0; id < n; ++id)
+        {
+            if (live_in[i].test(id))
+                extend(id, bb_start[i]);
+            if (live_out[i].test(id))
+                extend(id, bb_end[i]);
+        }
+        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for (size_t j = 0; j < bb->params.len; ++j)
+            extend(value_id[reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j])], bb_start[i]);
+        // 基本块参数在前驱的 jump/branch 处被写入;
+        getSuccessors(bb, succs);
+        for (auto s : succs)
+        {
+            for (size_t j = 0; j < s->params.len; ++j)
+                extend(value_id[reinterpret_cast<koopa_raw_value_t>(s->params.buffer[j])], bb_end[i]);
+        }
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            getOperands(inst, ops);
+            _expand_folded(ops, folded, fused);
+            for (auto op : ops)
+            {
+                auto it = value_id.find(op);
+                if (it != value_id.end())
+                    extend(it->second, pos);
+            }
+            auto it = value_id.find(inst);
+            if (it != value_id.end())
+                extend(it->second, pos + 1);
+            pos += 2;
+        }
+    }
+
+    // 区间内有 call (call 自己的返回值除外) 时不能使用调用者保存的寄存器;
+    for (auto &interval : intervals)
+    {
+        auto it = lower_bound(call_pos.begin(), call_pos.end(), interval.start);
+        interval.cross_call = it != call_pos.end() && *it < interval.end;
+    }
+
+    vector<int> order(n);
+    for (size_t i = 0; i < n; ++i)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](int a, int b)
+         { return intervals[a].start < intervals[b].start; });
+
+    vector<bool> reg_free(REG_NUM, true);
+    vector<int> active;
+    for (auto cur : order)
+    {
+        auto &interval = intervals[cur];
+
+        // 释放已经结束的区间;
+        for (size_t i = 0; i < active.size();)
+        {
+            if (intervals[active[i]].end < interval.start)
+            {
+                reg_free[intervals[active[i]].reg] = true;
+                active[i] = active.back();
+                active.pop_back();
+            }
+            else
+                i++;
+        }
+
+        int first = interval.cross_call ? CALLER_SAVED_NUM : 0;
+        for (int r = first; r < REG_NUM; ++r)
+        {
+            if (reg_free[r])
+            {
+                interval.reg = r;
+                break;
+            }
+        }
+        if (interval.reg >= 0)
+        {
+            reg_free[interval.reg] = false;
+            active.push_back(cur);
+            continue;
+        }
+
+        // 没有空闲寄存器, 溢出结束最晚的区间;
+        int spill = -1;
+        for (size_t i = 0; i < active.size(); ++i)
+        {
+            if (intervals[active[i]].reg < first)
+                continue;
+            if (spill == -1 || intervals[active[i]].end > intervals[active[spill]].end)
+                spill = i;
+        }
+        if (spill != -1 && intervals[active[spill]].end > interval.end)
+        {
+            interval.reg = intervals[active[spill]].reg;
+            intervals[active[spill]].reg = -1;
+            active[spill] = cur;
+        }
+    }
+
+    vector<bool> callee_used(REG_NUM, false);
+    for (auto &interval : intervals)
+    {
+        if (interval.reg < 0)
+            continue;
+        reg_table[interval.value] = interval.reg;
+        if (interval.reg >= CALLER_SAVED_NUM)
+            callee_used[interval.reg] = true;
+    }
+    for (int r = CALLER_SAVED_NUM; r < REG_NUM; ++r)
+        if (callee_used[r])
+            used_callee_saved.push_back(r);
+}
+
+bool RegAlloc::inReg(const koopa_raw_value_t &value)
+{
+    return reg_table.find(value) != reg_table.end();
+}
+
+string RegAlloc::getReg(const koopa_raw_value_t &value)
+{
+    assert(inReg(value));
+    return alloc_regs[reg_table[value]];
+}
+
+string RegAlloc::regName(int reg)
+{
+    assert(reg >= 0 && reg < REG_NUM);
+    return alloc_regs[reg];
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// 基于活跃区间的线性扫描寄存器分配, -O1 时启用;
+// t0-t2, t6 是代码生成用的临时寄存器, a0-a7 用于传参和返回值, 都不参与分配;
+// t3-t5 只分配给不跨越 call 的区间, 跨越 call 的区间只能使用 s0-s11;
+class RegAlloc
+{
+    unordered_map<koopa_raw_value_t, int> reg_table;
+    vector<int> used_callee_saved;
+
+public:
+    // 为函数中所有有返回值的指令 (alloc, 折叠的地址和合并进 branch 的比较除外) 以及函数参数和基本块参数分配寄存器,
+    // 分配失败的留在栈上;
+    void run(const koopa_raw_function_t &func, const unordered_set<koopa_raw_value_t> &folded,
+             const unordered_set<koopa_raw_value_t> &fused);
+    void clear();
+    bool inReg(const koopa_raw_value_t &value);
+    string getReg(const koopa_raw_value_t &value);
+    // 函数中用到的 s 寄存器, 需要在 prologue/epilogue 中保存和恢复;
+    const vector<int> &usedCalleeSaved() { return used_callee_saved; }
+    static string regName(int reg);
+};
+
+// 需要在栈上或寄存器中占据位置的 value;
+bool needLocation(const koopa_raw_value_t &value);
+// 只被 load/store/getelemptr/getptr 当作地址使用的 getelemptr/getptr 不单独计算, 折叠进使用者的寻址中;
+// 有多个使用者时只折叠下标全为常量的链, 否则要求唯一的使用者在同一个基本块中;
+void findFoldedAddrs(const koopa_raw_function_t &func, unordered_set<koopa_raw_value_t> &folded);
+// 唯一的使用者是同一个基本块末尾的 branch 条件的比较运算, 不计算出布尔值, 和 branch 合并为一条比较跳转指令;
+// 它的两个操作数在 branch 处读取;
+void findFusedCompares(const koopa_raw_function_t &func, unordered_set<koopa_raw_value_t> &fused);
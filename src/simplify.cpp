@@ -0,0 +1,306 @@
+#include "simplify.hpp"
+#include <climits>
+#include <cstdint>
+#include <iostream>
+
+static bool _is_int(const koopa_raw_value_t &value)
+{
+    return value->kind.tag == KOOPA_RVT_INTEGER;
+}
+
+static bool _is_int(const koopa_raw_value_t &value, int32_t c)
+{
+    return _is_int(value) && value->kind.data.integer.value == c;
+}
+
+bool isCompareOp(koopa_raw_binary_op_t op)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_NOT_EQ:
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_GT:
+    case KOOPA_RBO_LT:
+    case KOOPA_RBO_GE:
+    case KOOPA_RBO_LE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 结果只可能是 0 或 1 的 value;
+static bool _is_bool(const koopa_raw_value_t &value)
+{
+    return value->kind.tag == KOOPA_RVT_BINARY && isCompareOp(value->kind.data.binary.op);
+}
+
+// 按 RISC-V 的语义计算, 结果按 32 位补码回绕; 除以 0 不折叠;
+static bool _fold(koopa_raw_binary_op_t op, int32_t l, int32_t r, int32_t &res)
+{
+    uint32_t ul = l, ur = r;
+    switch (op)
+    {
+    case KOOPA_RBO_NOT_EQ:
+        res = l != r;
+        break;
+    case KOOPA_RBO_EQ:
+        res = l == r;
+        break;
+    case KOOPA_RBO_GT:
+        res = l > r;
+        break;
+    case KOOPA_RBO_LT:
+        res = l < r;
+        break;
+    case KOOPA_RBO_GE:
+        res = l >= r;
+        break;
+    case KOOPA_RBO_LE:
+        res = l <= r;
+        break;
+    case KOOPA_RBO_ADD:
+        res = ul + ur;
+        break;
+    case KOOPA_RBO_SUB:
+        res = ul - ur;
+        break;
+    case KOOPA_RBO_MUL:
+        res = ul * ur;
+        break;
+    case KOOPA_RBO_DIV:
+        if (!r)
+            return false;
+        res = l == INT_MIN && r == -1 ? INT_MIN : l / r;
+        break;
+    case KOOPA_RBO_MOD:
+        if (!r)
+            return false;
+        res = l == INT_MIN && r == -1 ? 0 : l % r;
+        break;
+    case KOOPA_RBO_AND:
+        res = l & r;
+        break;
+    case KOOPA_RBO_OR:
+        res = l | r;
+        break;
+    case KOOPA_RBO_XOR:
+        res = l ^ r;
+        break;
+    case KOOPA_RBO_SHL:
+        res = ul << (r & 31);
+        break;
+    case KOOPA_RBO_SHR:
+        res = ul >> (r & 31);
+        break;
+    case KOOPA_RBO_SAR:
+        res = l >> (r & 31);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool swapBinaryOp(koopa_raw_binary_op_t op, koopa_raw_binary_op_t &swapped)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_NOT_EQ:
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_ADD:
+    case KOOPA_RBO_MUL:
+    case KOOPA_RBO_AND:
+    case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+        swapped = op;
+        return true;
+    case KOOPA_RBO_GT:
+        swapped = KOOPA_RBO_LT;
+        return true;
+    case KOOPA_RBO_LT:
+        swapped = KOOPA_RBO_GT;
+        return true;
+    case KOOPA_RBO_GE:
+        swapped = KOOPA_RBO_LE;
+        return true;
+    case KOOPA_RBO_LE:
+        swapped = KOOPA_RBO_GE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 化简 binary 指令, 可以被已有的 value 替代时返回它, 否则原地改写并返回 nullptr;
+static koopa_raw_value_t _simplify_binary(koopa_raw_binary_t &binary, IRBuilder &ir_builder)
+{
+    auto &lhs = binary.lhs, &rhs = binary.rhs;
+    int32_t res;
+    if (_is_int(lhs) && _is_int(rhs))
+    {
+        if (_fold(binary.op, lhs->kind.data.integer.value, rhs->kind.data.integer.value, res))
+            return ir_builder.integer(res);
+        return nullptr;
+    }
+
+    koopa_raw_binary_op_t swapped;
+    if (_is_int(lhs) && swapBinaryOp(binary.op, swapped))
+    {
+        swap(lhs, rhs);
+        binary.op = swapped;
+    }
+
+    if (lhs == rhs)
+    {
+        switch (binary.op)
+        {
+        case KOOPA_RBO_SUB:
+        case KOOPA_RBO_XOR:
+        case KOOPA_RBO_NOT_EQ:
+        case KOOPA_RBO_LT:
+        case KOOPA_RBO_GT:
+            return ir_builder.integer(0);
+        case KOOPA_RBO_EQ:
+        case KOOPA_RBO_LE:
+        case KOOPA_RBO_GE:
+            return ir_builder.integer(1);
+        case KOOPA_RBO_AND:
+        case KOOPA_RBO_OR:
+            return lhs;
+        default:
+            return nullptr;
+        }
+    }
+
+    if (!_is_int(rhs))
+    {
+        // 0 移位后仍然是 0;
+        if (_is_int(lhs, 0))
+        {
+            switch (binary.op)
+            {
+            case KOOPA_RBO_SHL:
+            case KOOPA_RBO_SHR:
+            case KOOPA_RBO_SAR:
+                return lhs;
+            default:
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    int32_t c = rhs->kind.data.integer.value;
+    switch (binary.op)
+    {
+    case KOOPA_RBO_ADD:
+    case KOOPA_RBO_SUB:
+    case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+    case KOOPA_RBO_SHL:
+    case KOOPA_RBO_SHR:
+    case KOOPA_RBO_SAR:
+        if (c == 0)
+            return lhs;
+        break;
+    case KOOPA_RBO_MUL:
+        if (c == 0)
+            return rhs;
+        if (c == 1)
+            return lhs;
+        if (c == -1)
+        {
+            binary.op = KOOPA_RBO_SUB;
+            rhs = lhs;
+            lhs = ir_builder.integer(0);
+        }
+        break;
+    case KOOPA_RBO_DIV:
+        if (c == 1)
+            return lhs;
+        break;
+    case KOOPA_RBO_MOD:
+        if (c == 1 || c == -1)
+            return ir_builder.integer(0);
+        break;
+    case KOOPA_RBO_AND:
+        if (c == 0)
+            return rhs;
+        if (c == -1)
+            return lhs;
+        break;
+    case KOOPA_RBO_NOT_EQ:
+        if (c == 0 && _is_bool(lhs))
+            return lhs;
+        break;
+    case KOOPA_RBO_EQ:
+        if (c == 1 && _is_bool(lhs))
+            return lhs;
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+// 化简一个函数, 返回删除的指令数;
+static int _simplify_func(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    CFG cfg(func);
+    vector<int> order = cfg.rpo;
+    for (size_t i = 0; i < cfg.bbs.size(); ++i)
+        if (!cfg.reachable(i))
+            order.push_back(i);
+
+    // 按逆后序处理, 操作数 (包括回边上的实参) 的定义总是先于使用被化简;
+    unordered_map<koopa_raw_value_t, koopa_raw_value_t> replace;
+    auto resolve = [&](koopa_raw_value_t v)
+    {
+        auto it = replace.find(v);
+        return it == replace.end() ? v : it->second;
+    };
+
+    int removed = 0;
+    for (auto b : order)
+    {
+        auto bb = cfg.bbs[b];
+        vector<const void *> insts;
+        for (size_t j = 0; j < bb->insts.len; ++j)
+        {
+            auto inst = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            auto &kind = const_cast<koopa_raw_value_data_t *>(inst)->kind;
+            replaceOperands(inst, resolve);
+            if (kind.tag == KOOPA_RVT_BINARY)
+            {
+                auto value = _simplify_binary(kind.data.binary, ir_builder);
+                if (value)
+                {
+                    replace[inst] = value;
+                    removed++;
+                    continue;
+                }
+            }
+            else if (kind.tag == KOOPA_RVT_BRANCH && _is_int(kind.data.branch.cond))
+            {
+                auto branch = kind.data.branch;
+                bool taken = branch.cond->kind.data.integer.value != 0;
+                kind.tag = KOOPA_RVT_JUMP;
+                kind.data.jump.target = taken ? branch.true_bb : branch.false_bb;
+                kind.data.jump.args = taken ? branch.true_args : branch.false_args;
+            }
+            insts.push_back(inst);
+        }
+        if (insts.size() != bb->insts.len)
+            const_cast<koopa_raw_basic_block_data_t *>(bb)->insts = ir_builder.slice(insts, KOOPA_RSIK_VALUE);
+    }
+
+    return removed;
+}
+
+PassStats simplify(const koopa_raw_function_t &func, IRBuilder &ir_builder)
+{
+    PassStats stats("simplify", func);
+    stats.add("removed", _simplify_func(func, ir_builder));
+    return stats;
+}
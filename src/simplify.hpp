@@ -0,0 +1,17 @@
+#pragma once
+
+#include "koopa.h"
+#include "cfg.hpp"
+#include "ir_builder.hpp"
+#include "pass.hpp"
+
+// 常量折叠和代数化简, -O1 时在 mem2reg 之后运行;
+// 两个操作数都是常量的 binary 被折叠, x+0, x*1, x-x, 0*x 等恒等式被化简,
+// 常量操作数交换到右边 (比较运算同时翻转), 条件为常量的 branch 改为 jump;
+// 统计删除的指令数 (removed);
+PassStats simplify(const koopa_raw_function_t &func, IRBuilder &ir_builder);
+
+// 结果为 0 或 1 的比较运算;
+bool isCompareOp(koopa_raw_binary_op_t op);
+// 交换两个操作数后等价的运算, 不能交换时返回 false;
+bool swapBinaryOp(koopa_raw_binary_op_t op, koopa_raw_binary_op_t &swapped);
@@ -0,0 +1,149 @@
+#include "symbol_table.hpp"
+
+SymbolTableStack::SymbolTableStack()
+{
+    clear();
+
+    cerr << "//! construct symbol table stack\n";
+}
+
+void SymbolTableStack::clear()
+{
+    dep_label_no = 0;
+    id_arena.clear();
+    ids.clear();
+    visible.clear();
+    entries.clear();
+    scopes.clear();
+    scopes.push_back({0, 0, false});
+}
+
+int SymbolTableStack::intern(string_view id)
+{
+    auto it = ids.find(id);
+    if (it != ids.end())
+        return it->second;
+    // 键引用 id_arena 中的副本, 不依赖调用者的字符串;
+    string_view key(id_arena.newStr(id.data(), id.size()), id.size());
+    ids.emplace(key, visible.size());
+    visible.push_back(-1);
+    return visible.size() - 1;
+}
+
+const SymbolTableStack::Entry &SymbolTableStack::lookup(string_view id)
+{
+    auto it = ids.find(id);
+    if (it == ids.end() || visible[it->second] < 0)
+    {
+        cerr << "---Undefined symbol: " << id << "---" << endl;
+        assert(0);
+    }
+    return entries[visible[it->second]];
+}
+
+string SymbolTableStack::define(string_view id, Symbol symbol)
+{
+    int k = intern(id);
+    if (visible[k] >= (int)scopes.back().begin)
+    {
+        cerr << "---Symbol " << id << " has already been defined---" << endl;
+        assert(0);
+    }
+    string name = symbol.getName();
+    entries.push_back({move(symbol), k, visible[k]});
+    visible[k] = entries.size() - 1;
+    return name;
+}
+
+bool SymbolTableStack::inc()
+{
+    assert(!scopes.empty());
+    if (scopes.back().for_alloc_param)
+    {
+        cerr << "//! symbol table common\n";
+        scopes.back().for_alloc_param = false;
+        return true;
+    }
+    else
+    {
+        cerr << "//! symbol table inc, ";
+        dep_label_no++;
+        scopes.push_back({entries.size(), dep_label_no, false});
+        cerr << "now " << scopes.size() << endl;
+        return false;
+    }
+}
+
+void SymbolTableStack::dec()
+{
+    cerr << "//! symbol table dec, ";
+    assert(scopes.size() > 1);
+    // 按撤销日志恢复被本层遮蔽的定义;
+    while (entries.size() > scopes.back().begin)
+    {
+        visible[entries.back().id] = entries.back().shadowed;
+        entries.pop_back();
+    }
+    scopes.pop_back();
+    // 这里dep_lable_no不能减一, 否则重名;
+
+    cerr << "now " << scopes.size() << endl;
+}
+
+void SymbolTableStack::incParam()
+{
+    cerr << "//! symbol table inc param, ";
+    dep_label_no++;
+    scopes.push_back({entries.size(), dep_label_no, true});
+    cerr << "now " << scopes.size() << endl;
+}
+
+string SymbolTableStack::insert(string_view id, int val, SYM_TYPE s_type, DATA_TYPE d_type)
+{
+    cerr << "//! insert " << id << endl;
+
+    string name(id);
+    if (s_type != _FUNC)
+        name += "_" + to_string(scopes.back().label);
+    return define(id, Symbol(s_type, d_type, val, move(name)));
+}
+
+string SymbolTableStack::insert(string_view id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type)
+{
+    cerr << "//! insert array " << id << endl;
+
+    string name(id);
+    if (s_type != _FUNC)
+        name += "_" + to_string(scopes.back().label);
+    return define(id, Symbol(s_type, d_type, 0, move(name), move(shape)));
+}
+
+bool SymbolTableStack::exist(string_view id)
+{
+    auto it = ids.find(id);
+    return it != ids.end() && visible[it->second] >= 0;
+}
+
+const Symbol &SymbolTableStack::get(string_view id)
+{
+    return lookup(id).symbol;
+}
+
+const vector<int> &SymbolTableStack::getArray(string_view id)
+{
+    const Symbol &symbol = lookup(id).symbol;
+    assert(symbol.isArray());
+    return symbol.getShape();
+}
+
+const Symbol &SymbolTableStack::getFromGlobal(string_view id)
+{
+    // 沿遮蔽链找到全局作用域中的定义;
+    size_t global_end = scopes.size() > 1 ? scopes[1].begin : entries.size();
+    int i = lookup(id).id;
+    int k = visible[i];
+    while (k >= (int)global_end)
+        k = entries[k].shadowed;
+    assert(k >= 0);
+    return entries[k].symbol;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "arena.hpp"
+
+using namespace std;
+
+enum SYM_TYPE
+{
+    _CONST,
+    _VAR,
+    _FUNC,
+    CONST_ARRAY,
+    VAR_ARRAY
+};
+enum DATA_TYPE
+{
+    _INT,
+    _VOID
+};
+
+class Symbol
+{
+    SYM_TYPE symbol_type;
+    DATA_TYPE data_type;
+    int val;
+    string name;
+    vector<int> shape; // 数组的形状, 数组参数的第一维为 -1;
+
+public:
+    Symbol() : symbol_type(_CONST), data_type(_INT), val(0), name("") {}
+    Symbol(SYM_TYPE s_type, DATA_TYPE d_type, int v, string n, vector<int> s = {})
+        : symbol_type(s_type), data_type(d_type), val(v), name(move(n)), shape(move(s)) {}
+    bool isConst() const { return symbol_type == _CONST; }
+    bool isArray() const { return symbol_type == CONST_ARRAY || symbol_type == VAR_ARRAY; }
+    SYM_TYPE getSymbolType() const { return symbol_type; }
+    DATA_TYPE getDataType() const { return data_type; }
+    int getVal() const { return val; }
+    const string &getName() const { return name; }
+    const vector<int> &getShape() const { return shape; }
+};
+
+// 作用域符号表: 标识符驻留为编号, visible[编号] 是当前可见的定义;
+// 每个定义记录被它遮蔽的外层同名定义, 组成遮蔽链, 所以查找只需要一次哈希, 与嵌套深度和符号数无关;
+// 所有定义按顺序放在 entries 中, 同时作为撤销日志: 离开作用域时弹出本层的定义, 恢复被遮蔽的定义;
+class SymbolTableStack
+{
+    struct Entry
+    {
+        Symbol symbol;
+        int id;       // 标识符的驻留编号;
+        int shadowed; // 被遮蔽的同名定义在 entries 中的下标, 没有时为 -1;
+    };
+    struct Scope
+    {
+        size_t begin;         // 本层第一个定义在 entries 中的下标;
+        int label;            // 作用域编号, 局部变量名的后缀;
+        bool for_alloc_param; // 函数参数所在的作用域, 与函数体的最外层块共用;
+    };
+
+    // 下一个可用的变量dep_label;
+    int dep_label_no = 0;
+    Arena id_arena; // 驻留的标识符文本;
+    unordered_map<string_view, int> ids;
+    vector<int> visible;
+    deque<Entry> entries; // 插入时不移动已有元素, get 返回的引用在离开作用域前一直有效;
+    vector<Scope> scopes;
+
+    int intern(string_view id);
+    const Entry &lookup(string_view id);
+    string define(string_view id, Symbol symbol);
+
+public:
+    SymbolTableStack();
+    SymbolTableStack(const SymbolTableStack &) = delete;
+    SymbolTableStack &operator=(const SymbolTableStack &) = delete;
+    // 清空所有定义, 回到只有全局作用域的状态;
+    void clear();
+    // 增加一个符号表;
+    bool inc();
+    // 删除一个符号表;
+    void dec();
+    void incParam();
+    string insert(string_view id, int val, SYM_TYPE s_type, DATA_TYPE d_type);
+    string insert(string_view id, vector<int> shape, SYM_TYPE s_type, DATA_TYPE d_type);
+    bool exist(string_view id);
+    const Symbol &get(string_view id);
+    const vector<int> &getArray(string_view id);
+    const Symbol &getFromGlobal(string_view id);
+    int getDepLabelNo() { return dep_label_no; }
+};
@@ -1,5 +1,4 @@
 %code requires {
-  #include <memory>
   #include <string>
   #include "ast.hpp"
 }
@@ -7,37 +6,44 @@
 %{
 
 #include <iostream>
-#include <memory>
 #include <string>
 #include "ast.hpp"
 
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
-
 using namespace std;
 
 %}
 
+// 可重入的 parser: yylval 由 parser 传给 lexer, lexer 的状态都保存在 scanner 中
+// 同一个进程可以依次或在不同线程中同时解析多个程序
+%define api.pure full
+%lex-param { void *scanner }
+
 // 定义 parser 函数和错误处理函数的附加参数
-// 我们需要返回一个字符串作为 AST, 所以我们把附加参数定义成字符串的智能指针
-// 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的字符串
-%parse-param { std::unique_ptr<BaseAST> &ast }
+// 解析完成后, 我们要手动修改这个参数, 把它设置成解析得到的 AST 根节点
+// 所有节点都分配在调用者传入的 ast_arena 中, 由调用者统一释放
+%parse-param { BaseAST *&ast } { void *scanner } { Arena &ast_arena }
 
 
 // yylval 的定义, 我们把它定义成了一个联合体 (union)
 // 因为 token 的值有的是字符串指针, 有的是整数
 // 之前我们在 lexer 中用到的 str_val 和 int_val 就是在这里被定义的
-// 至于为什么要用字符串指针而不直接用 string 或者 unique_ptr<string>?
-// 请自行 STFW 在 union 里写一个带析构函数的类会出现什么情况
+// 字符串和列表都分配在 ast_arena 中, union 里只放指针
 %union {
-  std::string *str_val;
+  const char *str_val;
   int int_val;
   BaseAST *ast_val;
-  std::vector<std::unique_ptr<BaseAST>> *vec_val;
-  std::vector<std::unique_ptr<FuncFParamAST>> *funcf_vec_val;
-  std::vector<std::unique_ptr<ConstInitValAST>> *const_init_vec_val;
-  std::vector<std::unique_ptr<InitValAST>> *init_vec_val;
+  ArenaVec<BaseAST *> *vec_val;
+  ArenaVec<FuncFParamAST *> *funcf_vec_val;
+  ArenaVec<ConstInitValAST *> *const_init_vec_val;
+  ArenaVec<InitValAST *> *init_vec_val;
+}
+
+%code {
+  // 声明 lexer 函数和错误处理函数, 以及错误处理用到的 scanner 接口
+  int yylex(YYSTYPE *yylval, void *scanner);
+  void yyerror(BaseAST *&ast, void *scanner, Arena &ast_arena, const char *s);
+  char *yyget_text(void *scanner);
+  int yyget_lineno(void *scanner);
 }
 
 
@@ -53,7 +59,7 @@ using namespace std;
 %type <ast_val> BlockItem LVal Decl ConstDecl ConstDef ConstInitVal VarDecl VarDef InitVal ConstExp
 %type <ast_val> FuncFParams FuncFParam  FuncRParams 
 %type <int_val> Number
-%type <str_val> UnaryOp
+%type <int_val> UnaryOp
 %type <vec_val> BlockItemList ConstDefList VarDefList ExprList ConstExpList ArrayExpList
 %type <funcf_vec_val> FuncFParamList 
 %type <const_init_vec_val> ConstInitValList
@@ -69,37 +75,37 @@ using namespace std;
 StartSymbol
   : CompUnit {
     std::cerr<<"//! start\n";
-    auto start_symbol = make_unique<StartSymbolAST>();
-    start_symbol->compunit = unique_ptr<BaseAST>($1);
-    ast = move(start_symbol);
+    auto start_symbol = ast_arena.make<StartSymbolAST>();
+    start_symbol->compunit = $1;
+    ast = start_symbol;
   }
   ;
 
 CompUnit
   : FuncDef {
     std::cerr<<"//! compunit->funcdef\n";
-    auto func_def = unique_ptr<BaseAST>($1);
-    auto ast = new CompUnitAST(func_def, 0);
+    auto func_def = $1;
+    auto ast = ast_arena.make<CompUnitAST>(func_def, 0);
     $$ = ast;
   }
   | Decl {
     std::cerr<<"//! compunit->decl\n";
-    auto decl = unique_ptr<BaseAST>($1);
-    auto ast = new CompUnitAST(decl, 1);
+    auto decl = $1;
+    auto ast = ast_arena.make<CompUnitAST>(decl, 1);
     $$ = ast;
   }
   | CompUnit FuncDef {
     std::cerr<<"//! compunit->compunit funcdef\n";
-    auto compunit = unique_ptr<BaseAST>($1);
-    auto func_def = unique_ptr<BaseAST>($2);
-    auto ast = new CompUnitAST(compunit, func_def, 0);
+    auto compunit = $1;
+    auto func_def = $2;
+    auto ast = ast_arena.make<CompUnitAST>(compunit, func_def, 0);
     $$ = ast;
   }
   | CompUnit Decl {
     std::cerr<<"//! compunit->compunit decl\n";
-    auto compunit = unique_ptr<BaseAST>($1);
-    auto decl = unique_ptr<BaseAST>($2);
-    auto ast = new CompUnitAST(compunit, decl, 1);
+    auto compunit = $1;
+    auto decl = $2;
+    auto ast = ast_arena.make<CompUnitAST>(compunit, decl, 1);
     $$ = ast;
   }
   ;
@@ -108,41 +114,36 @@ CompUnit
 // 我们这里可以直接写 '(' 和 ')', 因为之前在 lexer 里已经处理了单个字符的情况
 // 解析完成后, 把这些符号的结果收集起来, 然后拼成一个新的字符串, 作为结果返回
 // $$ 表示非终结符的返回值, 我们可以通过给这个符号赋值的方法来返回结果
-// 你可能会问, FuncType, IDENT 之类的结果已经是字符串指针了
-// 为什么还要用 unique_ptr 接住它们, 然后再解引用, 把它们拼成另一个字符串指针呢
-// 因为所有的字符串指针都是我们 new 出来的, new 出来的内存一定要 delete
-// 否则会发生内存泄漏, 而 unique_ptr 这种智能指针可以自动帮我们 delete
-// 虽然此处你看不出用 unique_ptr 和手动 delete 的区别, 但当我们定义了 AST 之后
-// 这种写法会省下很多内存管理的负担
+// 节点和字符串都在 ast_arena 中, 不需要逐个 delete, 生成 IR 之后整体释放
 FuncDef
   : INT IDENT '(' ')' Block {
-    auto ast = new FuncDefAST();
+    auto ast = ast_arena.make<FuncDefAST>();
     ast->functype = "int";
-    ast->ident = *unique_ptr<string>($2);
-    ast->block = unique_ptr<BaseAST>($5);
+    ast->ident = $2;
+    ast->block = $5;
     $$ = ast;
   }
   | INT IDENT '(' FuncFParams ')' Block {
-    auto ast = new FuncDefAST();
+    auto ast = ast_arena.make<FuncDefAST>();
     ast->functype = "int";
-    ast->ident = *unique_ptr<string>($2);
-    ast->params = make_optional(unique_ptr<FuncFParamsAST>(dynamic_cast<FuncFParamsAST*>($4)));
-    ast->block = unique_ptr<BaseAST>($6);
+    ast->ident = $2;
+    ast->params = dynamic_cast<FuncFParamsAST *>($4);
+    ast->block = $6;
     $$ = ast;
   }
   | VOID IDENT '(' ')' Block {
-    auto ast = new FuncDefAST();
+    auto ast = ast_arena.make<FuncDefAST>();
     ast->functype = "void";
-    ast->ident = *unique_ptr<string>($2);
-    ast->block = unique_ptr<BaseAST>($5);
+    ast->ident = $2;
+    ast->block = $5;
     $$ = ast;
   }
   | VOID IDENT '(' FuncFParams ')' Block {
-    auto ast = new FuncDefAST();
+    auto ast = ast_arena.make<FuncDefAST>();
     ast->functype = "void";
-    ast->ident = *unique_ptr<string>($2);
-    ast->params = make_optional(unique_ptr<FuncFParamsAST>(dynamic_cast<FuncFParamsAST*>($4)));
-    ast->block = unique_ptr<BaseAST>($6);
+    ast->ident = $2;
+    ast->params = dynamic_cast<FuncFParamsAST *>($4);
+    ast->block = $6;
     $$ = ast;
   }
   ;
@@ -153,144 +154,138 @@ FuncDef
 
 FuncFParams
   : FuncFParamList {
-    auto ast = new FuncFParamsAST();
-    auto vec = ($1);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->funcfparams.push_back(move(*it));
+    auto ast = ast_arena.make<FuncFParamsAST>();
+    ast->funcfparams = *$1;
     $$ = ast;
   }
   ;
 
 FuncFParamList
   : FuncFParam {
-    auto vec = new vector<unique_ptr<FuncFParamAST>>;
-    auto param = unique_ptr<FuncFParamAST>(dynamic_cast<FuncFParamAST*>($1));
-    vec->push_back(move(param));
+    auto vec = ast_arena.make<ArenaVec<FuncFParamAST *>>(&ast_arena);
+    auto param = dynamic_cast<FuncFParamAST *>($1);
+    vec->push_back(param);
     $$ = vec;
   }
   | FuncFParamList ',' FuncFParam {
     auto vec = ($1);
-    auto param = unique_ptr<FuncFParamAST>(dynamic_cast<FuncFParamAST*>($3));
-    vec->push_back(move(param));
+    auto param = dynamic_cast<FuncFParamAST *>($3);
+    vec->push_back(param);
     $$ = vec;
   }
   ;
 
 FuncFParam
   : INT IDENT {
-    auto ast = new FuncFParamAST(0);
+    auto ast = ast_arena.make<FuncFParamAST>(0);
     ast->btype = "int";
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
     $$ = ast;
   }
   | INT IDENT '[' ']' {
-    auto ast = new FuncFParamAST(1);
+    auto ast = ast_arena.make<FuncFParamAST>(1);
     ast->btype = "int";
-    ast->ident = *unique_ptr<string>($2);
+    ast->ident = $2;
     $$ = ast;
   }
   | INT IDENT '[' ']' ConstExpList{
-    auto ast = new FuncFParamAST(1);
+    auto ast = ast_arena.make<FuncFParamAST>(1);
     ast->btype = "int";
-    ast->ident = *unique_ptr<string>($2);
-    auto vec = $5;
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constexps.push_back(move(*it));
+    ast->ident = $2;
+    ast->constexps = *$5;
     $$ = ast;
   }
   ;
 
 Block
   : '{' BlockItemList '}' {
-    auto ast = new BlockAST();
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->blockitems.push_back(move(*it));
+    auto ast = ast_arena.make<BlockAST>();
+    ast->blockitems = *$2;
     $$ = ast;
   }
   ;
 
 BlockItemList
   : {
-    auto vec = new vector<unique_ptr<BaseAST>>;
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
     $$ = vec;
   }
   | BlockItemList BlockItem {
     auto vec = ($1);
-    vec->push_back(unique_ptr<BaseAST>($2));
+    vec->push_back($2);
     $$ = vec;
   }
   ;
 
 BlockItem
   : Decl {
-    auto decl = unique_ptr<BaseAST>($1);
-    auto ast = new BlockItemAST(decl, true);
+    auto decl = $1;
+    auto ast = ast_arena.make<BlockItemAST>(decl, true);
     $$ = ast;
   }
   | Stmt {  
-    auto stmt = unique_ptr<BaseAST>($1);
-    auto ast = new BlockItemAST(stmt, false);
+    auto stmt = $1;
+    auto ast = ast_arena.make<BlockItemAST>(stmt, false);
     $$ = ast;
   }
   ;
 
 Stmt
   : LVal '=' Expr ';' {
-    auto lval = unique_ptr<BaseAST>($1);
-    auto expr = unique_ptr<BaseAST>($3);
-    auto ast = new StmtAST(lval, expr);
+    auto lval = $1;
+    auto expr = $3;
+    auto ast = ast_arena.make<StmtAST>(lval, expr);
     $$ = ast;
   }
   | ';' {
-    auto ast = new StmtAST(2);
+    auto ast = ast_arena.make<StmtAST>(2);
     $$ = ast;
   }
   | Expr ';' {
-    auto expr = unique_ptr<BaseAST>($1);
-    auto ast = new StmtAST(expr, 2);
+    auto expr = $1;
+    auto ast = ast_arena.make<StmtAST>(expr, 2);
     $$ = ast;
   }
   | Block {
-    auto block = unique_ptr<BaseAST>($1);
-    auto ast = new StmtAST(block, 3);
+    auto block = $1;
+    auto ast = ast_arena.make<StmtAST>(block, 3);
     $$ = ast;
   }
   | RETURN ';' {
-    auto ast = new StmtAST(1);
+    auto ast = ast_arena.make<StmtAST>(1);
     $$ = ast;
   }
   | RETURN Expr ';' {
-    auto expr = unique_ptr<BaseAST>($2);
-    auto ast = new StmtAST(expr, 1);
+    auto expr = $2;
+    auto ast = ast_arena.make<StmtAST>(expr, 1);
     $$ = ast;
   }
   | IF '(' Expr ')' Stmt {
-    auto expr = unique_ptr<BaseAST>($3);
-    auto ifstmt = unique_ptr<BaseAST>($5);
-    auto ast = new IfStmtAST(expr, ifstmt);
+    auto expr = $3;
+    auto ifstmt = $5;
+    auto ast = ast_arena.make<IfStmtAST>(expr, ifstmt);
     $$ = ast;
   }
   | IF '(' Expr ')' Stmt ELSE Stmt {
-    auto expr = unique_ptr<BaseAST>($3);
-    auto ifstmt = unique_ptr<BaseAST>($5);
-    auto elsestmt = unique_ptr<BaseAST>($7);
-    auto ast = new IfStmtAST(expr, ifstmt, elsestmt);
+    auto expr = $3;
+    auto ifstmt = $5;
+    auto elsestmt = $7;
+    auto ast = ast_arena.make<IfStmtAST>(expr, ifstmt, elsestmt);
     $$ = ast;
 
   }
   | WHILE '(' Expr ')' Stmt{
-    auto expr = unique_ptr<BaseAST>($3);
-    auto whilestmt = unique_ptr<BaseAST>($5);
-    auto ast = new WhileStmtAST(expr, whilestmt);
+    auto expr = $3;
+    auto whilestmt = $5;
+    auto ast = ast_arena.make<WhileStmtAST>(expr, whilestmt);
     $$ = ast;
   }
   | BREAK ';' {
-    auto ast = new BrConStmtAST(0);
+    auto ast = ast_arena.make<BrConStmtAST>(0);
     $$ = ast;
   }
   | CONTINUE ';' {
-    auto ast = new BrConStmtAST(1);
+    auto ast = ast_arena.make<BrConStmtAST>(1);
     $$ = ast;
   }
   ;
@@ -299,73 +294,69 @@ Stmt
 Decl
   : ConstDecl {
     cerr<<"//! decl->constdecl\n";
-    auto constdecl = unique_ptr<BaseAST>($1);
-    auto ast = new DeclAST(constdecl, true);
+    auto constdecl = $1;
+    auto ast = ast_arena.make<DeclAST>(constdecl, true);
     $$ = ast;
   }
   | VarDecl {
     cerr<<"//! decl->vardecl\n";
-    auto vardecl = unique_ptr<BaseAST>($1);
-    auto ast = new DeclAST(vardecl, false);
+    auto vardecl = $1;
+    auto ast = ast_arena.make<DeclAST>(vardecl, false);
     $$ = ast;
   }
   ;
 
 ConstDecl
   : CONST INT ConstDefList ';' {
-    auto ast = new ConstDeclAST();
+    auto ast = ast_arena.make<ConstDeclAST>();
     ast->btype = "int";
-    auto vec = ($3); 
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constdefs.push_back(move(*it));
+    ast->constdefs = *$3;
     $$ = ast;
   }
   ;
 
 ConstDefList
   : ConstDef {
-    auto vec = new vector<unique_ptr<BaseAST>>;
-    auto constdef = unique_ptr<BaseAST>($1);
-    vec->push_back(move(constdef));
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
+    auto constdef = $1;
+    vec->push_back(constdef);
     $$ = vec;
   }
   | ConstDefList ',' ConstDef {
     auto vec = $1;
-    auto constdef = unique_ptr<BaseAST>($3);
-    vec->push_back(move(constdef));
+    auto constdef = $3;
+    vec->push_back(constdef);
     $$ = vec;
   }
   ;
 
 ConstDef
   : IDENT '=' ConstInitVal {
-    auto ast = new ConstDefAST(0);
-    ast->ident = *unique_ptr<string>($1);
-    ast->constinitval=unique_ptr<ConstInitValAST>(dynamic_cast<ConstInitValAST*>($3));
+    auto ast = ast_arena.make<ConstDefAST>(0);
+    ast->ident = $1;
+    ast->constinitval=dynamic_cast<ConstInitValAST *>($3);
     $$ = ast;
   }
   | IDENT ConstExpList '=' ConstInitVal {
-    auto ast = new ConstDefAST(1);
-    ast->ident = *unique_ptr<string>($1);
-    ast->constinitval=unique_ptr<ConstInitValAST>(dynamic_cast<ConstInitValAST*>($4));
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constexps.push_back(move(*it));
+    auto ast = ast_arena.make<ConstDefAST>(1);
+    ast->ident = $1;
+    ast->constinitval=dynamic_cast<ConstInitValAST *>($4);
+    ast->constexps = *$2;
     $$ = ast;
   }
   ;
 
 ConstExpList
   : '[' ConstExp ']' {
-    auto vec = new vector<unique_ptr<BaseAST>>;
-    auto constexp = unique_ptr<BaseAST>($2);
-    vec->push_back(move(constexp));
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
+    auto constexp = $2;
+    vec->push_back(constexp);
     $$ = vec;
   }
   | ConstExpList '[' ConstExp ']' {
     auto vec = $1;
-    auto constexp = unique_ptr<BaseAST>($3);
-    vec->push_back(move(constexp));
+    auto constexp = $3;
+    vec->push_back(constexp);
     $$ = vec;
   }
   ;
@@ -373,34 +364,32 @@ ConstExpList
 
 ConstInitVal
   : ConstExp {
-    auto ast = new ConstInitValAST(0);
-    ast->constexp = unique_ptr<BaseAST>($1);
+    auto ast = ast_arena.make<ConstInitValAST>(0);
+    ast->constexp = $1;
     $$ = ast;
   }
   | '{' '}'{
-    auto ast = new ConstInitValAST(1);
+    auto ast = ast_arena.make<ConstInitValAST>(1);
     $$ = ast;
   }
   | '{' ConstInitValList '}' {
-    auto ast = new ConstInitValAST(1);
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constinitvals.push_back(move(*it));
+    auto ast = ast_arena.make<ConstInitValAST>(1);
+    ast->constinitvals = *$2;
     $$ = ast;
   }
   ;
 
 ConstInitValList
   : ConstInitVal {
-    auto constinitval = unique_ptr<ConstInitValAST>(dynamic_cast<ConstInitValAST*>($1));
-    auto vec = new vector<unique_ptr<ConstInitValAST>>;
-    vec->push_back(move(constinitval));
+    auto constinitval = dynamic_cast<ConstInitValAST *>($1);
+    auto vec = ast_arena.make<ArenaVec<ConstInitValAST *>>(&ast_arena);
+    vec->push_back(constinitval);
     $$ = vec;
   }
   | ConstInitValList ',' ConstInitVal {
     auto vec = $1;
-    auto constinitval = unique_ptr<ConstInitValAST>(dynamic_cast<ConstInitValAST*>($3));
-    vec->push_back(move(constinitval));
+    auto constinitval = dynamic_cast<ConstInitValAST *>($3);
+    vec->push_back(constinitval);
     $$ = vec;
   }
   ;
@@ -408,11 +397,9 @@ ConstInitValList
 VarDecl
   : INT VarDefList ';' {
     cerr<<"//! vardecl->vardeflist\n";
-    auto ast = new VarDeclAST();
+    auto ast = ast_arena.make<VarDeclAST>();
     ast->btype = "int";
-    auto vec = ($2); 
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->vardefs.push_back(move(*it));
+    ast->vardefs = *$2;
     $$ = ast;
   }
   ;
@@ -420,16 +407,16 @@ VarDecl
 VarDefList
   : VarDef {
     cerr<<"//! vardeflist->vardef\n";
-    auto vec = new vector<unique_ptr<BaseAST>>;
-    auto vardef = unique_ptr<BaseAST>($1);
-    vec->push_back(move(vardef));
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
+    auto vardef = $1;
+    vec->push_back(vardef);
     $$ = vec;
   }
   | VarDefList ',' VarDef {
     cerr<<"//! vardeflist->vardeflist vardef\n";
     auto vec = $1;
-    auto vardef = unique_ptr<BaseAST>($3);
-    vec->push_back(move(vardef));
+    auto vardef = $3;
+    vec->push_back(vardef);
     $$ = vec;
   }
   ;
@@ -438,34 +425,30 @@ VarDef
   : IDENT {
     cerr<<"//! vardef-> ident\n";
     auto ident = ($1);
-    auto ast = new VarDefAST(ident, 0);
+    auto ast = ast_arena.make<VarDefAST>(ident, 0);
     $$ = ast;
   }
   | IDENT '=' InitVal {
     cerr<<"//! vardef -> ident=init\n";
     auto ident = ($1);
-    auto initval = unique_ptr<InitValAST>(dynamic_cast<InitValAST*>($3));
-    auto ast = new VarDefAST(ident, initval, 0);
+    auto initval = dynamic_cast<InitValAST *>($3);
+    auto ast = ast_arena.make<VarDefAST>(ident, initval, 0);
     $$ = ast;
   }
   | IDENT ConstExpList {
     cerr<<"//! vardef -> ident[]\n";
     auto ident = ($1);
-    auto ast = new VarDefAST(ident, 1);
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constexps.push_back(move(*it));
+    auto ast = ast_arena.make<VarDefAST>(ident, 1);
+    ast->constexps = *$2;
     $$ = ast;
   }
   | IDENT ConstExpList '=' InitVal
   {
     cerr<<"//! vardef -> ident[]=init\n";
     auto ident = ($1);
-    auto initval = unique_ptr<InitValAST>(dynamic_cast<InitValAST*>($4));
-    auto ast = new VarDefAST(ident, initval, 1);
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->constexps.push_back(move(*it));
+    auto initval = dynamic_cast<InitValAST *>($4);
+    auto ast = ast_arena.make<VarDefAST>(ident, initval, 1);
+    ast->constexps = *$2;
     $$ = ast;
   }
   ;
@@ -473,20 +456,18 @@ VarDef
 InitVal
   : Expr {
     cerr<<"//! init->exp\n";
-    auto ast = new InitValAST(0);
-    ast->expr = unique_ptr<BaseAST>($1);
+    auto ast = ast_arena.make<InitValAST>(0);
+    ast->expr = $1;
     $$ = ast;
   }
   |'{' '}'{
-    auto ast = new InitValAST(1);
+    auto ast = ast_arena.make<InitValAST>(1);
     $$ = ast;
   }
   | '{' InitValList '}' {
     cerr<<"//! init -> initlist\n";
-    auto ast = new InitValAST(1);
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->initvals.push_back(move(*it));
+    auto ast = ast_arena.make<InitValAST>(1);
+    ast->initvals = *$2;
     $$ = ast;
   }
   ;
@@ -494,16 +475,16 @@ InitVal
 InitValList
   : InitVal {
     cerr<<"//! initlist-> initval\n";
-    auto vec = new vector<unique_ptr<InitValAST>>;
-    auto initval = unique_ptr<InitValAST>(dynamic_cast<InitValAST*>($1));
-    vec->push_back(move(initval));
+    auto vec = ast_arena.make<ArenaVec<InitValAST *>>(&ast_arena);
+    auto initval = dynamic_cast<InitValAST *>($1);
+    vec->push_back(initval);
     $$ = vec;
   }
   | InitValList ',' InitVal {
     cerr<<"//! initlist-> initlist\n";
     auto vec = $1;
-    auto initval = unique_ptr<InitValAST>(dynamic_cast<InitValAST*>($3));
-    vec->push_back(move(initval));
+    auto initval = dynamic_cast<InitValAST *>($3);
+    vec->push_back(initval);
     $$ = vec;
   }
   ;
@@ -511,9 +492,7 @@ InitValList
 
 ConstExp
   : Expr {
-    auto ast = new ConstExpAST();
-    ast->expr = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   ;
 
@@ -523,262 +502,225 @@ Number
   }
   ;
 
+// 只有一个子节点的表达式产生式直接返回子节点, 不再为每一层优先级生成节点
 Expr
   : LOrExp{
-    auto ast = new ExprAST();
-    ast->lorexp = unique_ptr<BaseAST>($1);
-    $$ = ast;
+    $$ = $1;
   }
   ;
 
 PrimaryExp
   : '(' Expr ')'  {
-    auto expr = unique_ptr<BaseAST>($2);
-    auto ast = new PrimaryExpAST(expr, 0);
-    $$ = ast;
+    $$ = $2;
   }
   | Number{
     auto number = (int)($1);
-    auto ast = new PrimaryExpAST(number);
+    auto ast = ast_arena.make<NumberExpAST>(number);
     $$ = ast;
   }
   | LVal {
-    auto lval = unique_ptr<BaseAST>($1);
-    auto ast = new PrimaryExpAST(lval, 1);
-    $$ = ast;
+    auto lval = dynamic_cast<LValAST *>($1);
+    lval->is_rval = true;
+    $$ = lval;
   }
   ;
 
 LVal
   : IDENT {
-    auto ast = new LValAST(0);
-    ast->ident = *unique_ptr<string>($1);
+    auto ast = ast_arena.make<LValAST>(0);
+    ast->ident = $1;
     $$ = ast;
   }
   | IDENT ArrayExpList {
-    auto ast = new LValAST(1);
-    ast->ident = *unique_ptr<string>($1);
-    auto vec = ($2);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->exprs.push_back(move(*it));
+    auto ast = ast_arena.make<LValAST>(1);
+    ast->ident = $1;
+    ast->exprs = *$2;
     $$ = ast;
   }
   ;
 
 ArrayExpList
   : '[' Expr ']' {
-    auto vec = new vector<unique_ptr<BaseAST>>;
-    auto expr = unique_ptr<BaseAST>($2);
-    vec->push_back(move(expr));
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
+    auto expr = $2;
+    vec->push_back(expr);
     $$ = vec;
   }
   | ArrayExpList '[' Expr ']' {
     auto vec = $1;
-    auto expr = unique_ptr<BaseAST>($3);
-    vec->push_back(move(expr));
+    auto expr = $3;
+    vec->push_back(expr);
     $$ = vec;
   }
   ;
 
 UnaryExp
   : PrimaryExp {
-    auto primary = unique_ptr<BaseAST>($1);
-    auto ast = new UnaryExpAST(primary);
-    $$ = ast;
+    $$ = $1;
   }
   | UnaryOp UnaryExp{
-    auto unaryexp = unique_ptr<BaseAST>($2);
-    auto ast = new UnaryExpAST($1, unaryexp);
+    auto unaryexp = $2;
+    auto ast = ast_arena.make<UnaryExpAST>((EXP_OP)$1, unaryexp);
     $$ = ast;
   }
   | IDENT '(' ')'  {
-    auto ast = new FuncUnaryExpAST();
-    ast->ident = *unique_ptr<string>($1);
+    auto ast = ast_arena.make<FuncUnaryExpAST>();
+    ast->ident = $1;
     $$ = ast;
   }
   | IDENT '(' FuncRParams ')'  {
-    auto ast = new FuncUnaryExpAST();
-    ast->ident = *unique_ptr<string>($1);
-    ast->params = make_optional(unique_ptr<FuncRParamsAST>(dynamic_cast<FuncRParamsAST*>($3)));
+    auto ast = ast_arena.make<FuncUnaryExpAST>();
+    ast->ident = $1;
+    ast->params = dynamic_cast<FuncRParamsAST *>($3);
     $$ = ast;
   }
   ;
 
 FuncRParams
   : ExprList {
-    auto ast = new FuncRParamsAST();
-    auto vec = ($1);
-    for (auto it = vec->begin(); it != vec->end(); it++)
-      ast->funcrparams.push_back(move(*it));
+    auto ast = ast_arena.make<FuncRParamsAST>();
+    ast->funcrparams = *$1;
     $$ = ast;
   }
   ;
 
 ExprList
   : Expr {
-    auto vec = new vector<unique_ptr<BaseAST>>;
-    auto expr = unique_ptr<BaseAST>($1);
-    vec->push_back(move(expr));
+    auto vec = ast_arena.make<ArenaVec<BaseAST *>>(&ast_arena);
+    auto expr = $1;
+    vec->push_back(expr);
     $$ = vec;
   }
   | ExprList ',' Expr {
     auto vec = $1;
-    auto expr = unique_ptr<BaseAST>($3);
-    vec->push_back(move(expr));
+    auto expr = $3;
+    vec->push_back(expr);
     $$ = vec;
   }
   ;
 
 UnaryOp
   : '+' {
-    string *op = new string("+");
-    $$ = op;
+    $$ = OP_POS;
   }
   | '-' {
-    string *op = new string("-");
-    $$ = op;
+    $$ = OP_NEG;
   }
   | '!' {
-    string *op = new string("!");
-    $$ = op;
+    $$ = OP_NOT;
   }
   ;
 
 MulExp
   : UnaryExp {
-    auto unaryexp = unique_ptr<BaseAST>($1);
-    auto ast = new MulExpAST(unaryexp);
-    $$ = ast;
+    $$ = $1;
   }
   | MulExp '*' UnaryExp {
-    auto mulexp = unique_ptr<BaseAST>($1);
-    string *op = new string("*");
-    auto unaryexp = unique_ptr<BaseAST>($3);
-    auto ast = new MulExpAST(mulexp, op, unaryexp);
+    auto mulexp = $1;
+    auto unaryexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_MUL, mulexp, unaryexp);
     $$ = ast;
   }
   | MulExp '/' UnaryExp {
-    auto mulexp = unique_ptr<BaseAST>($1);
-    string *op = new string("/");
-    auto unaryexp = unique_ptr<BaseAST>($3);
-    auto ast = new MulExpAST(mulexp, op, unaryexp);
+    auto mulexp = $1;
+    auto unaryexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_DIV, mulexp, unaryexp);
     $$ = ast;
   }
   | MulExp '%' UnaryExp {
-    auto mulexp = unique_ptr<BaseAST>($1);
-    string *op = new string("%");
-    auto unaryexp = unique_ptr<BaseAST>($3);
-    auto ast = new MulExpAST(mulexp, op, unaryexp);
+    auto mulexp = $1;
+    auto unaryexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_MOD, mulexp, unaryexp);
     $$ = ast;
   }
   ;
 
 AddExp
   : MulExp {
-    auto mulexp = unique_ptr<BaseAST>($1);
-    auto ast = new AddExpAST(mulexp);
-    $$ = ast;
+    $$ = $1;
   }
   | AddExp '+' MulExp {
-    auto addexp = unique_ptr<BaseAST>($1);
-    string *op = new string("+");
-    auto mulexp = unique_ptr<BaseAST>($3);
-    auto ast = new AddExpAST(addexp, op, mulexp);
+    auto addexp = $1;
+    auto mulexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_ADD, addexp, mulexp);
     $$ = ast;
   }
   | AddExp '-' MulExp {
-    auto addexp = unique_ptr<BaseAST>($1);
-    string *op = new string("-");
-    auto mulexp = unique_ptr<BaseAST>($3);
-    auto ast = new AddExpAST(addexp, op, mulexp);
+    auto addexp = $1;
+    auto mulexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_SUB, addexp, mulexp);
     $$ = ast;
   }
   ;
 
 RelExp
   : AddExp {
-    auto addexp = unique_ptr<BaseAST>($1);
-    auto ast = new RelExpAST(addexp);
-    $$ = ast;
+    $$ = $1;
   }
   | RelExp '<' AddExp {
-    auto relexp = unique_ptr<BaseAST>($1);
-    string *op = new string("<");
-    auto addexp = unique_ptr<BaseAST>($3);
-    auto ast = new RelExpAST(relexp, op, addexp);
+    auto relexp = $1;
+    auto addexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_LT, relexp, addexp);
     $$ = ast;
   }
   | RelExp '>' AddExp {
-    auto relexp = unique_ptr<BaseAST>($1);
-    string *op = new string(">");
-    auto addexp = unique_ptr<BaseAST>($3);
-    auto ast = new RelExpAST(relexp, op, addexp);
+    auto relexp = $1;
+    auto addexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_GT, relexp, addexp);
     $$ = ast;
   }
   | RelExp LEQ AddExp {
-    auto relexp = unique_ptr<BaseAST>($1);
-    string *op = new string("<=");
-    auto addexp = unique_ptr<BaseAST>($3);
-    auto ast = new RelExpAST(relexp, op, addexp);
+    auto relexp = $1;
+    auto addexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_LE, relexp, addexp);
     $$ = ast;
   }
   | RelExp GEQ AddExp {
-    auto relexp = unique_ptr<BaseAST>($1);
-    string *op = new string(">=");
-    auto addexp = unique_ptr<BaseAST>($3);
-    auto ast = new RelExpAST(relexp, op, addexp);
+    auto relexp = $1;
+    auto addexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_GE, relexp, addexp);
     $$ = ast;
   }
   ;
 
 EqExp
   : RelExp {
-    auto relexp = unique_ptr<BaseAST>($1);
-    auto ast = new EqExpAST(relexp);
-    $$ = ast;
+    $$ = $1;
   }
   | EqExp EQ RelExp {
-    auto eqexp = unique_ptr<BaseAST>($1);
-    string *op = new string("==");
-    auto relexp = unique_ptr<BaseAST>($3);
-    auto ast = new EqExpAST(eqexp, op, relexp);
+    auto eqexp = $1;
+    auto relexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_EQ, eqexp, relexp);
     $$ = ast;
   }
   | EqExp NEQ RelExp {
-    auto eqexp = unique_ptr<BaseAST>($1);
-    string *op = new string("!=");
-    auto relexp = unique_ptr<BaseAST>($3);
-    auto ast = new EqExpAST(eqexp, op, relexp);
+    auto eqexp = $1;
+    auto relexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_NE, eqexp, relexp);
     $$ = ast;
   }
   ;
 
 LAndExp
   : EqExp {
-    auto eqexp = unique_ptr<BaseAST>($1);
-    auto ast = new LAndExpAST(eqexp);
-    $$ = ast;
+    $$ = $1;
   }
   | LAndExp LAND EqExp {
-    auto landexp = unique_ptr<BaseAST>($1);
-    string *op = new string("&&");
-    auto eqexp = unique_ptr<BaseAST>($3);
-    auto ast = new LAndExpAST(landexp, op, eqexp);
+    auto landexp = $1;
+    auto eqexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_LAND, landexp, eqexp);
     $$ = ast;
   }
   ;
 
 LOrExp
   : LAndExp {
-    auto landexp = unique_ptr<BaseAST>($1);
-    auto ast = new LOrExpAST(landexp);
-    $$ = ast;
+    $$ = $1;
   }
   | LOrExp LOR LAndExp {
-    auto lorexp = unique_ptr<BaseAST>($1);
-    string *op = new string("||");
-    auto landexp = unique_ptr<BaseAST>($3);
-    auto ast = new LOrExpAST(lorexp, op, landexp);
+    auto lorexp = $1;
+    auto landexp = $3;
+    auto ast = ast_arena.make<BinaryExpAST>(OP_LOR, lorexp, landexp);
     $$ = ast;
   }
   ;
@@ -786,10 +728,10 @@ LOrExp
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s) {
+void yyerror(BaseAST *&ast, void *scanner, Arena &ast_arena, const char *s) {
   
-    extern int yylineno;    // defined and maintained in lex
-    extern char *yytext;    // defined and maintained in lex
+    char *yytext = yyget_text(scanner);       // defined and maintained in lex
+    int yylineno = yyget_lineno(scanner);     // defined and maintained in lex
     int len=strlen(yytext);
     int i;
     char buf[512]={0};
@@ -0,0 +1,101 @@
+#include "thread_pool.hpp"
+#include <cassert>
+
+// 当前线程在所属线程池中的编号, 不是工作线程时为 -1;
+static thread_local const ThreadPool *cur_pool = nullptr;
+static thread_local size_t cur_worker = -1;
+
+ThreadPool::ThreadPool(size_t n)
+{
+    if (!n)
+        n = max(1u, thread::hardware_concurrency());
+    for (size_t i = 0; i < n; ++i)
+        workers.push_back(make_unique<Worker>());
+    for (size_t i = 0; i < n; ++i)
+        threads.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto &t : threads)
+        t.join();
+}
+
+void ThreadPool::submit(function<void()> task)
+{
+    // 计数必须在任务放入队列之前增加, 否则任务可能在计数之前被窃取并执行完, pending 提前归零;
+    size_t id;
+    {
+        lock_guard<mutex> lock(m);
+        id = cur_pool == this ? cur_worker : next++ % workers.size();
+        queued++;
+        pending++;
+    }
+    {
+        lock_guard<mutex> lock(workers[id]->m);
+        workers[id]->tasks.push_back(move(task));
+    }
+    cv.notify_one();
+}
+
+bool ThreadPool::pop(size_t id, function<void()> &task)
+{
+    // 先从自己的队尾取, 再按顺序从其他队列的队首窃取;
+    for (size_t k = 0; k < workers.size(); ++k)
+    {
+        Worker &w = *workers[(id + k) % workers.size()];
+        lock_guard<mutex> lock(w.m);
+        if (w.tasks.empty())
+            continue;
+        if (k == 0)
+        {
+            task = move(w.tasks.back());
+            w.tasks.pop_back();
+        }
+        else
+        {
+            task = move(w.tasks.front());
+            w.tasks.pop_front();
+        }
+        lock_guard<mutex> count_lock(m);
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t id)
+{
+    cur_pool = this;
+    cur_worker = id;
+    for (;;)
+    {
+        function<void()> task;
+        if (pop(id, task))
+        {
+            task();
+            lock_guard<mutex> lock(m);
+            if (--pending == 0)
+                done_cv.notify_all();
+            continue;
+        }
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [&]
+                { return stop || queued > 0; });
+        if (stop && queued == 0)
+            return;
+    }
+}
+
+void ThreadPool::wait()
+{
+    assert(cur_pool != this);
+    unique_lock<mutex> lock(m);
+    done_cv.wait(lock, [&]
+                 { return pending == 0; });
+}
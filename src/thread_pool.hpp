@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 工作窃取线程池: 每个线程有自己的任务队列, 从队尾取自己的任务, 自己的队列空了再从其他线程的队首窃取;
+// 任务之间没有依赖, 提交的任务都执行完后 wait() 返回;
+class ThreadPool
+{
+    struct Worker
+    {
+        mutex m;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+
+    mutex m;
+    condition_variable cv, done_cv;
+    size_t queued = 0;  // 还在队列中的任务数;
+    size_t pending = 0; // 还没有执行完的任务数;
+    size_t next = 0;    // 外部线程提交时轮流放入各个队列;
+    bool stop = false;
+
+    bool pop(size_t id, function<void()> &task);
+    void run(size_t id);
+
+public:
+    // n 为 0 时使用硬件线程数;
+    explicit ThreadPool(size_t n = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // 工作线程提交的任务放入自己的队列, 其他线程提交的任务轮流放入各个队列;
+    void submit(function<void()> task);
+    // 等待所有已提交的任务执行完, 不能在工作线程中调用;
+    void wait();
+    size_t size() { return threads.size(); }
+};